@@ -0,0 +1,96 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_APPROX_COUNTER_H
+#define RANGETREE_APPROX_COUNTER_H
+
+#include "fc_range_tree.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Approximate counting of the points in a query range with a guaranteed relative error, next to a fractional cascading
+ * range tree. The points are mapped to rank space, where a grid of 2^s x 2^s rank cells puts about the same number of
+ * points in every column and row, and each level of such grids stores the 2D prefix counts of its cells. A query is
+ * mapped to ranks through bucketed lookup tables, then bracketed between the cells it fully covers and the cells it
+ * touches in O(1) per level. Levels are tried from the coarsest, which stays in cache, and the first one whose bracket
+ * is within epsilon answers the query. Queries too thin for the finest level fall back to the exact count of the tree.
+ */
+class ApproxCounter {
+public:
+    /**
+     * @param tree Answers the queries that no level can bound, must be constructed from the same points as build and
+     *             must not be reconstructed while in use
+     * @param epsilon Maximum relative error of a count, must be positive
+     * @param memoryBudget Bytes that the count grids of all levels may take, the finest level is the densest one that
+     *                     fits. The rank lookup tables take another 16 bytes per point on top of it.
+     */
+    ApproxCounter(FcRangeTree& tree, double epsilon, std::size_t memoryBudget);
+
+    /**
+     * Build the rank lookup tables and the count grids in O(n log n + memoryBudget) time
+     * @param points
+     */
+    void build(const std::vector<Point>& points);
+
+    /**
+     * @param query Query that specify the range in each dimension
+     * @return The number of points in the query range, within a factor of 1 +- epsilon
+     */
+    std::size_t count(Query query);
+
+    /**
+     * @return Number of queries answered by the exact count of the tree so far
+     */
+    std::size_t fallbacks() const { return mFallbacks; }
+
+    /**
+     * @return Bytes taken by the count grids of all levels
+     */
+    std::size_t grid_bytes() const;
+
+private:
+    // Sorted coordinates of one dimension, with the first rank of every bucket of the value range so that a value is
+    // only searched for among the ranks of its own bucket
+    struct RankTable {
+        /**
+         * @param values Coordinates of all points in this dimension, get sorted
+         */
+        void build(std::vector<uint32_t> values);
+
+        // number of coordinates < value
+        uint32_t rank_below(uint32_t value) const;
+
+        // number of coordinates <= value
+        uint32_t rank_upto(uint32_t value) const;
+
+        std::vector<uint32_t> values;
+        std::vector<uint32_t> bucketStarts;
+        uint32_t min = 0;
+        uint32_t shift = 0;
+    };
+
+    // Grid of (2^shift)-rank cells, prefix[i * stride + j] counts the points with x-rank < i << shift and
+    // y-rank < j << shift
+    struct Level {
+        uint32_t shift;
+        std::size_t stride;
+        std::vector<uint32_t> prefix;
+    };
+
+    FcRangeTree& mTree;
+    double mEpsilon;
+    std::size_t mMemoryBudget;
+
+    std::size_t mNumPoints = 0;
+    RankTable mXRanks, mYRanks;
+    // coarsest level first
+    std::vector<Level> mLevels;
+
+    std::size_t mFallbacks = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_APPROX_COUNTER_H
@@ -0,0 +1,283 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_ASYNC_QUERY_H
+#define RANGETREE_ASYNC_QUERY_H
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <utility>
+
+#include "fc_range_tree.h"
+#include "thread_pool.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Awaitable that suspends the awaiting coroutine and resumes it on a worker of the given pool
+ */
+struct ScheduleAwaiter {
+    ThreadPool& pool;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        pool.submit([handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+};
+
+inline ScheduleAwaiter schedule(ThreadPool& pool) {
+    return ScheduleAwaiter{pool};
+}
+
+/**
+ * Lazily started coroutine producing a single value of type T, the awaiting coroutine is resumed once it finishes
+ */
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            return FinalAwaiter{};
+        }
+
+        void return_value(T newValue) { value.emplace(std::move(newValue)); }
+
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (mHandle)
+            mHandle.destroy();
+    }
+
+    auto operator co_await() {
+        struct TaskAwaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() {
+                if (handle.promise().error)
+                    std::rethrow_exception(handle.promise().error);
+
+                return std::move(*handle.promise().value);
+            }
+        };
+
+        return TaskAwaiter{mHandle};
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+/**
+ * Asynchronous generator, the consumer awaits next() to resume the producer until its next co_yield, which returns an
+ * empty optional once the producer finished
+ */
+template <typename T>
+class AsyncGenerator {
+public:
+    struct promise_type {
+        std::optional<T> current;
+        std::exception_ptr error;
+        std::coroutine_handle<> consumer;
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // hand the control back to the consumer, either with a new value or with the end of the sequence
+        struct TransferAwaiter {
+            bool await_ready() const noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().consumer;
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        TransferAwaiter final_suspend() noexcept {
+            current.reset();
+            return {};
+        }
+
+        TransferAwaiter yield_value(T value) {
+            current.emplace(std::move(value));
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    AsyncGenerator(AsyncGenerator&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    ~AsyncGenerator() {
+        if (mHandle)
+            mHandle.destroy();
+    }
+
+    /**
+     * @return Awaitable of the next value, or an empty optional if the producer finished
+     */
+    auto next() {
+        struct NextAwaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return handle.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().consumer = awaiting;
+                return handle;
+            }
+
+            std::optional<T> await_resume() {
+                if (handle.promise().error)
+                    std::rethrow_exception(handle.promise().error);
+
+                if (handle.done())
+                    return std::nullopt;
+
+                return std::move(handle.promise().current);
+            }
+        };
+
+        return NextAwaiter{mHandle};
+    }
+
+private:
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+namespace detail {
+
+// Eagerly started coroutine that nobody awaits, its frame is destroyed as soon as it finishes
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+
+        std::suspend_never initial_suspend() noexcept { return {}; }
+
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template <typename T>
+struct SyncWaitState {
+    std::optional<T> value;
+    std::exception_ptr error;
+    std::binary_semaphore done{0};
+};
+
+// the state is shared so that it outlives the release() even if the waiting thread returns right away
+template <typename T>
+DetachedTask sync_wait_driver(Task<T>& task, std::shared_ptr<SyncWaitState<T>> state) {
+    try {
+        state->value.emplace(co_await task);
+    }
+    catch (...) {
+        state->error = std::current_exception();
+    }
+
+    state->done.release();
+}
+
+} // namespace detail
+
+/**
+ * Block the calling thread until the task finishes, mainly used at the boundary of synchronous code
+ * @param task
+ * @return The value produced by the task
+ */
+template <typename T>
+T sync_wait(Task<T> task) {
+    auto state = std::make_shared<detail::SyncWaitState<T>>();
+    detail::sync_wait_driver(task, state);
+    state->done.acquire();
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+
+    return std::move(*state->value);
+}
+
+/**
+ * Report all the points in the query range on a worker of the pool without blocking the caller. The tree must outlive
+ * the returned task.
+ * @param tree Any range tree engine
+ * @param query
+ * @param pool Executor to run the query on
+ * @return Awaitable result of the query
+ */
+Task<std::vector<Point>> report_points_async(IRangeTree& tree, Query query, ThreadPool& pool = ThreadPool::shared());
+
+/**
+ * Stream the points in the query range in blocks of at most blockSize points. The canonical runs are enumerated lazily,
+ * so the first block is ready after O(log n) work instead of after the whole query. The tree must outlive the
+ * returned generator.
+ * @param tree
+ * @param query
+ * @param blockSize Maximum number of points in a block
+ * @param pool Executor to run the enumeration on
+ * @return Asynchronous generator of point blocks
+ */
+AsyncGenerator<std::vector<Point>> stream_points(FcRangeTree& tree, Query query, std::size_t blockSize,
+                                                 ThreadPool& pool = ThreadPool::shared());
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_ASYNC_QUERY_H
@@ -0,0 +1,44 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_BATCH_COUNTER_H
+#define RANGETREE_BATCH_COUNTER_H
+
+#include <thread>
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Offline counting of the points in a whole batch of queries. Each query becomes two x-events, count(x_upper) minus
+ * count(x_lower - 1), which are answered by a single sweep along x with a Fenwick tree over rank-compressed y, so the
+ * batch takes O((n + q) log n) time without building a range tree.
+ *
+ * The parallel version splits the sweep into x-slabs of about the same number of points. The Fenwick tree of a slab
+ * starts from the y-histogram of all the slabs to its left, so the slabs are swept independently on the workers of
+ * ThreadPool::shared(). The histograms of all the slabs are held at once, numSlabs * (number of distinct y) * 4 bytes,
+ * i.e. up to 4 * n bytes per slab, the number of slabs is capped by numThreads and by n / 2^16.
+ */
+class BatchCounter {
+public:
+    /**
+     * @param numThreads Maximum number of x-slabs swept in parallel, default as the number of hardware threads
+     */
+    explicit BatchCounter(std::size_t numThreads = std::thread::hardware_concurrency());
+
+    /**
+     * @param points
+     * @param queries
+     * @return Number of points in each of the queries, in the order of queries
+     */
+    std::vector<std::size_t> count(const std::vector<Point>& points, const std::vector<Query>& queries);
+
+private:
+    std::size_t mNumThreads;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_BATCH_COUNTER_H
@@ -0,0 +1,77 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_CURVE_ORDER_H
+#define RANGETREE_CURVE_ORDER_H
+
+#include <string>
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+// Space-filling curve that points are renumbered along
+enum class CurveKind {
+    Morton,
+    Hilbert
+};
+
+std::string to_string(CurveKind kind);
+
+/**
+ * @return Position of (x, y) along the Z-order curve over the 32-bit plane, the interleaved bits of y and x
+ */
+uint64_t morton_index(uint32_t x, uint32_t y);
+
+/**
+ * @return Position of (x, y) along the Hilbert curve over the 32-bit plane, which unlike the Z-order curve never
+ *         jumps between cells that are not adjacent
+ */
+uint64_t hilbert_index(uint32_t x, uint32_t y);
+
+/**
+ * Pre-pass that renumbers points along a space-filling curve before the trees are built. Points close in the plane get
+ * close ids, so the ids reported for a rectangle fall into a few dense ranges: a layout that keeps only ids and looks
+ * the coordinates up in the id-ordered columns below reads them mostly sequentially, and sorted result ids compress
+ * well as small deltas. The original ids are kept to map results back.
+ */
+class CurveRenumbering {
+public:
+    /**
+     * Reorder the points along the curve and give them the ids 1..n in that order
+     * @param points Points to be renumbered in-place
+     * @param kind
+     */
+    void renumber(std::vector<Point>& points, CurveKind kind);
+
+    /**
+     * @param id An id given by renumber
+     * @return The id the point had before renumber
+     */
+    uint32_t original_id(uint32_t id) const { return mOriginalIds[id]; }
+
+    /**
+     * Replace the ids given by renumber with the original ones, e.g. in the result of a query
+     * @param points
+     */
+    void restore_ids(std::vector<Point>& points) const;
+
+    /**
+     * @param id An id given by renumber
+     * @return The point of the id, with the id given by renumber
+     */
+    Point point_of(uint32_t id) const;
+
+    std::size_t size() const { return mXs.size() - 1; }
+
+private:
+    // indexed by the new id, the entry 0 is unused as ids start at 1
+    std::vector<uint32_t> mOriginalIds{0};
+    std::vector<uint32_t> mXs{0};
+    std::vector<uint32_t> mYs{0};
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_CURVE_ORDER_H
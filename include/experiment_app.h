@@ -8,6 +8,17 @@
 #include "data_generator.h"
 #include "org_range_tree.h"
 #include "fc_range_tree.h"
+#include "query_planner.h"
+#include "async_query.h"
+#include "point_loader.h"
+#include "range_aggregator.h"
+#include "batch_counter.h"
+#include "snapshot_manager.h"
+#include "tracer.h"
+#include "platform.h"
+#include "approx_counter.h"
+#include "query_replay.h"
+#include "curve_order.h"
 
 namespace Xiuge::RangeTree {
 
@@ -22,8 +33,185 @@ public:
 
     void query_time_query_range(const std::vector<double>& queryRangePers);
 
+    void query_time_planner(const std::vector<double>& queryRangePers);
+
+    void query_time_async(const std::vector<double>& queryRangePers);
+
+    void query_stats_query_range(const std::vector<double>& queryRangePers);
+
+    void load_time_data_length(const std::vector<uint32_t>& dataLens);
+
+    void construct_time_sort_backend(const std::vector<uint32_t>& dataLens);
+
+    void construct_time_lazy(const std::vector<uint32_t>& dataLens);
+
+    void query_time_batch(const std::vector<uint32_t>& dataLens, const std::vector<std::size_t>& groupSizes);
+
+    void query_time_secondary_layout(const std::vector<double>& queryRangePers);
+
+    void query_time_aggregate(const std::vector<double>& queryRangePers);
+
+    void query_time_batch_count(const std::vector<uint32_t>& queryCounts);
+
+    void query_latency_rebuild(const std::vector<uint32_t>& dataLens);
+
+    void construct_time_index_width(const std::vector<uint32_t>& dataLens);
+
+    void query_time_scan_kernel(const std::vector<uint32_t>& dataLens);
+
+    void query_time_leaf_size(const std::vector<std::size_t>& leafSizes);
+
+    void query_time_query_threads(const std::vector<std::size_t>& threadCounts);
+
+    void trace_construct_and_batch(uint32_t dataLen, const std::string& tracePath);
+
+    void query_time_cache_mode(const std::vector<double>& queryRangePers, std::size_t numInstances);
+
+    void query_time_approx_count(const std::vector<double>& queryRangePers, double epsilon, std::size_t memoryBudget);
+
+    void construct_time_collapse(const std::vector<uint32_t>& universeSizes);
+
+    void query_latency_open_loop(const std::vector<double>& qpsRates, uint64_t latencyTargetUs,
+                                 const std::string& tracePath);
+
+    void query_locality_curve(const std::vector<double>& queryRangePers);
+
+    void query_time_delta(const std::vector<double>& panStepPers);
+
+    void query_time_batch_order(const std::vector<uint32_t>& queryCounts);
+
+    /**
+     * Log the CPU layout, cache sizes and frequency of the machine. The calling thread is not pinned, since every
+     * thread it spawns would inherit the pin, only the single-thread timed loops pin to the cpu while they run.
+     * @param cpu Cpu the timed loops pin to
+     */
+    void describe_platform(std::size_t cpu);
+
 private:
+    /**
+     * Run the queries with traversal counters on the given tree, log the average latency along with the counters
+     * @param tree Either OrgRangeTree or FcRangeTree
+     * @param treeName Name of the tree in the log
+     * @param queryVec
+     * @param range
+     */
+    template <typename Tree>
+    void query_stats(Tree& tree, const std::string& treeName, std::vector<Query>& queryVec, uint32_t range);
+
+    /**
+     * Construct the tree eagerly or lazily, log time to construct, time to first query and time of a skewed workload
+     * @param tree Either OrgRangeTree or FcRangeTree
+     * @param treeName Name of the tree in the log
+     * @param lazy
+     * @param dataVec
+     * @param queryVec Queries of the skewed workload
+     */
+    template <typename Tree>
+    void lazy_time(Tree& tree, const std::string& treeName, bool lazy, std::vector<Point> dataVec,
+                   std::vector<Query>& queryVec);
+
+    /**
+     * Construct a fractional cascading range tree with the given index type, log construction time, memory of the
+     * secondary arrays and query time
+     * @param indexName Name of the index type in the log
+     * @param dataVec
+     * @param queryVec
+     */
+    template <typename Index>
+    void index_width_time(const std::string& indexName, std::vector<Point> dataVec, std::vector<Query>& queryVec);
+
+    /**
+     * Run the queries on the scan engine, the baseline of every sweep, log the average running time
+     * @param scanEngine Constructed scan engine
+     * @param engineName Name of the engine in the log
+     * @param queryVec
+     * @param len Data length
+     * @param range Query range
+     */
+    void scan_query_time(ScanEngine& scanEngine, const std::string& engineName, std::vector<Query>& queryVec,
+                         uint32_t len, uint32_t range);
+
+    /**
+     * Construct the tree with the given leaf bucket size, log construction time and query time
+     * @param tree Either OrgRangeTree or FcRangeTree
+     * @param treeName Name of the tree in the log
+     * @param leafSize
+     * @param dataVec
+     * @param queryVec
+     * @param range Query range
+     */
+    template <typename Tree>
+    void leaf_size_time(Tree& tree, const std::string& treeName, std::size_t leafSize, std::vector<Point> dataVec,
+                        std::vector<Query>& queryVec, uint32_t range);
+
+    /**
+     * Run the queries on the tree, whose number of threads per query is already set, log the average running time
+     * @param tree Either OrgRangeTree or FcRangeTree
+     * @param treeName Name of the tree in the log
+     * @param numThreads Number of threads per query
+     * @param queryVec
+     * @param range Query range
+     */
+    void query_threads_time(IRangeTree& tree, const std::string& treeName, std::size_t numThreads,
+                            std::vector<Query>& queryVec, uint32_t range);
+
+    /**
+     * Log the query time of the queries in three cache states: warm, back to back on one tree; cold, with the caches
+     * flushed before every query; rotating, every query on every tree in a random order
+     * @param trees Instances of either OrgRangeTree or FcRangeTree built on the same points
+     * @param treeName Name of the tree in the log
+     * @param queryVec
+     * @param range Query range
+     * @param flusher
+     */
+    template <typename Tree>
+    void cache_mode_time(std::vector<std::unique_ptr<Tree>>& trees, const std::string& treeName,
+                         std::vector<Query>& queryVec, uint32_t range, CacheFlusher& flusher);
+
+    /**
+     * Construct a fractional cascading range tree with or without collapsing duplicate x-coordinates, log
+     * construction time, number of nodes, memory of the secondary arrays and query time
+     * @param collapse
+     * @param dataVec
+     * @param queryVec
+     * @param universe Size of the universe of the points
+     */
+    void collapse_time(bool collapse, std::vector<Point> dataVec, std::vector<Query>& queryVec, uint32_t universe);
+
+    /**
+     * Replay the trace open-loop on the tree at each rate, log the latency percentiles and the achieved rate, then
+     * search for the highest rate whose p99 latency meets the target
+     * @param tree Constructed engine
+     * @param treeName Name of the tree in the log
+     * @param trace
+     * @param qpsRates
+     * @param latencyTargetNs
+     */
+    void open_loop_latency(IRangeTree& tree, const std::string& treeName, const QueryTrace& trace,
+                           const std::vector<double>& qpsRates, uint64_t latencyTargetNs);
+
+    /**
+     * Query the Fractional Cascading Range Tree built on points numbered in some order, then measure how the reported
+     * ids cluster, the bytes of the sorted ids as delta varints, and the time to look the coordinates up by id as an
+     * id-only secondary layout would
+     * @param orderName
+     * @param dataVec Points with ids 1..n in the order, copied
+     * @param queryVec
+     */
+    void curve_locality(const std::string& orderName, std::vector<Point> dataVec, std::vector<Query>& queryVec);
+
+    /**
+     * Answer the query set with report_points_batch, once in the order given and once deduplicated and reordered along
+     * the Hilbert curve
+     * @param tree
+     * @param setName Name of the query set
+     * @param queryVec
+     */
+    void batch_order_time(FcRangeTree& tree, const std::string& setName, std::vector<Query>& queryVec);
+
     DataGenerator mDataGenerator;
+    // cpu the single-thread timed loops pin to
+    std::size_t mTimingCpu = 0;
 };
 
 } // namespace ::Xiuge::RangeTree
@@ -5,63 +5,289 @@
 #ifndef RANGETREE_FD_RANGE_TREE_H
 #define RANGETREE_FD_RANGE_TREE_H
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #include "types.h"
+#include "radix_sort.h"
 
 namespace Xiuge::RangeTree {
 
 /**
  * Implementation of Fractional Cascading Range Tree
+ * @tparam Index Type of the indices into the secondary arrays, bounds the number of points of the tree. One of
+ *               uint32_t, PackedIndex40 or uint64_t. The 32 bit Point::id bounds it to UINT32_MAX points regardless.
  */
-class FcRangeTree : IRangeTree {
+template <typename Index>
+class BasicFcRangeTree : public IRangeTree {
 public:
+    using Node = BasicFcRangeTreeNode<Index>;
+    using SecNode = BasicFcNode<Index>;
+    using Run = BasicFcRun<Index>;
+
+    // number of queries report_points_batch keeps in flight by default
+    static constexpr std::size_t DEFAULT_GROUP_SIZE = 8;
+
+    ~BasicFcRangeTree() override;
+
     void construct_tree(std::vector<Point>& points, bool ) override;
 
-    void report_points(Query query, std::vector<Point>& foundPts) override;
+    /**
+     * Select the algorithm of the two pre-sorts in construct_tree
+     * @param backend Either std::sort or the parallel LSD radix sort
+     */
+    void set_sort_backend(SortBackend backend) { mSortBackend = backend; }
+
+    /**
+     * Stop the recursion of the primary tree at ranges of at most leafSize points, each becomes a leaf bucket whose
+     * points are only kept in its own secondary array and scanned, which saves about log(leafSize) levels of
+     * secondary arrays and most of the nodes. Takes effect on next construct_tree.
+     * @param leafSize 1 for a leaf per point
+     */
+    void set_leaf_size(std::size_t leafSize) { mLeafSize = leafSize > 0 ? leafSize : 1; }
+
+    /**
+     * Collapse all the points sharing an x-coordinate into a single node of the primary tree, which keeps them as a
+     * y-sorted run and reports the ones in the y range with one bulk copy. The primary tree and the number of levels
+     * of secondary arrays then grow with the number of distinct x-coordinates rather than with the number of points,
+     * which pays off on small universes. Takes effect on next construct_tree.
+     * @param collapse
+     */
+    void set_collapse_duplicates(bool collapse) { mCollapseDuplicates = collapse; }
+
+    /**
+     * Let a single query with a large answer copy its canonical runs on up to numThreads threads of
+     * ThreadPool::shared(), each into its own slice of the output at prefix offsets of the runs
+     * @param numThreads 1 to copy on the calling thread only
+     */
+    void set_query_threads(std::size_t numThreads) { mQueryThreads = numThreads > 0 ? numThreads : 1; }
+
+    /**
+     * Let report_points_batch answer identical queries of a batch once, and answer the distinct ones in the order of
+     * their centres along a Hilbert curve, so that queries in the same group and in consecutive groups tend to walk
+     * the same paths and read the same secondary arrays while they are still cached. The results are scattered back
+     * in the original order of the batch.
+     * @param reorder
+     */
+    void set_batch_reorder(bool reorder) { mBatchReorder = reorder; }
+
+    /**
+     * In lazy mode construct_tree only builds the primary tree, the secondary array of a node is built on its first
+     * access, so memory grows only with the part of the tree actually queried. Takes effect on next construct_tree.
+     * @param lazy
+     */
+    void set_lazy(bool lazy) { mLazy = lazy; }
+
+    /**
+     * Build all the secondary arrays that are not yet built on a background thread, top down. Only for lazy mode.
+     */
+    void warm_up_async();
+
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+    /**
+     * Same as report_points, and also count how the query traversed the tree
+     * @param query Query that specify the range in each dimension
+     * @param foundPts All points that are in the query range.
+     * @param stats Traversal counters of this query, will be added to
+     * @param limit Maximum number of points to report
+     */
+    void report_points(Query query, std::vector<Point>& foundPts, QueryStats& stats, std::size_t limit = NO_LIMIT);
+
+    /**
+     * Answer a batch of queries, groupSize of them are advanced through the primary tree and the cascade in lockstep.
+     * Each step prefetches the next node or secondary array slot of every query in the group before any of them is
+     * dereferenced, so the cache misses of the group overlap instead of forming one dependent chain per query.
+     * @param queries
+     * @param results Points in range of queries[i] are appended to results[i], resized to the number of queries
+     * @param groupSize Number of queries in flight
+     */
+    void report_points_batch(const std::vector<Query>& queries, std::vector<std::vector<Point>>& results,
+                             std::size_t groupSize = DEFAULT_GROUP_SIZE);
+
+    /**
+     * Report the k points with the lowest y-coordinates in the query range, ascendingly by y and break tie by id. The
+     * y-sorted canonical runs are merged with a heap of O(log n) heads, so it takes O(log n + k log log n) time.
+     * @param query Query that specify the range in each dimension
+     * @param k Number of points to report
+     * @param foundPts The lowest k points, or all the points in range if there are fewer than k
+     */
+    void report_lowest_y(Query query, std::size_t k, std::vector<Point>& foundPts);
+
+    /**
+     * Count the points in the query range in O(log n) time without enumerating them
+     * @param query Query that specify the range in each dimension
+     * @return The number of points in the query range
+     */
+    std::size_t count_points(Query query);
+
+    /**
+     * Report how the answer changes when a query is panned or resized, e.g. the viewport of a map client. The part of
+     * each rectangle outside the other one is split into at most four thin rectangles that are queried instead, so the
+     * cost grows with the change rather than with the size of the answer.
+     * @param previous Query whose answer the caller already holds
+     * @param query Query that replaces it
+     * @param enteredPts Points in range of query but not of previous, will be appended to
+     * @param leftPts Points in range of previous but not of query, will be appended to
+     */
+    void report_delta(Query previous, Query query, std::vector<Point>& enteredPts, std::vector<Point>& leftPts);
+
+    /**
+     * Decompose the query into the points on the two search paths and the canonical runs hanging off them, the union
+     * of both is exactly the answer of the query.
+     * @param query Query that specify the range in each dimension
+     * @param pathPts Points on the search paths that are in the query range
+     * @param runs Canonical runs, each of them is a y-sorted slice of a node's secondary array
+     */
+    void find_canonical(Query query, std::vector<Point>& pathPts, std::vector<Run>& runs);
+
+    /**
+     * Visit every node of the tree in pre-order, mainly used to attach per-node data keyed by Node::index.
+     * In lazy mode all the secondary arrays are built first.
+     * @param visitor
+     */
+    void for_each_node(const std::function<void(const Node*)>& visitor);
 
 private:
     /* construction helper function */
     /**
      * Build a weighted balance binary search tree based on a sorted vector of points in O(n) time
      * @param points A vector of points, must be sorted ascedingly.
-     * @param start Start point of the vector.
-     * @param end End point of the vector.
+     * @param begin First point of the vector.
+     * @param end One past the last point of the vector.
+     * @param leafSize Ranges of at most this many points become a leaf bucket
+     * @param collapse True if the points sharing an x-coordinate go to a single node, a range of a single
+     *                 x-coordinate becomes a leaf bucket regardless of its size
      * @return A pointer point to the root of the tree.
      */
-    static std::unique_ptr<FcRangeTreeNode> build_tree(std::vector<Point>& points, const int start, const int end);
+    static std::unique_ptr<Node> build_tree(std::vector<Point>& points, std::size_t begin, std::size_t end,
+                                            std::size_t leafSize, bool collapse);
 
     /**
      * Recursively build secondary fractional cascading array for each of the node in the range tree
      * @param node Start node
      */
-    static void build_sec_dim_array(FcRangeTreeNode* node);
+    static void build_sec_dim_array(Node* node);
+
+    /**
+     * Link each entry of the node's secondary array to its children's secondary arrays, or fill the x column of a
+     * leaf bucket
+     * @param node Node whose secondary array is already filled
+     */
+    static void link_sec_dim_array(Node* node);
+
+    /**
+     * Make sure the secondary array of the node is built, a no-op unless in lazy mode. Thread safe.
+     * @param node
+     */
+    void ensure_sec_dim_array(Node* node);
+
+    /**
+     * Stop and join the background warm up thread, if there is one
+     */
+    void stop_warm_up();
 
     /* range query helper function */
+    // cursor of a walk from lca down to one of the two search targets
+    struct PathWalk {
+        Node* node;
+        Node* target;
+        // cascaded indices of the first y >= y_lower and the first y > y_upper in node's secondary array
+        std::size_t lower;
+        std::size_t upper;
+        bool toLeft;
+        bool toSucc;
+    };
+
+    /**
+     * Implementation of report_points, the counters are compiled out unless CollectStats
+     */
+    template <bool CollectStats>
+    void report_points_impl(Query query, std::vector<Point>& foundPts, std::size_t limit, QueryStats* stats);
+
+    /**
+     * Implementation of find_canonical, the counters are compiled out unless CollectStats
+     */
+    template <bool CollectStats>
+    void find_canonical_impl(Query query, std::vector<Point>& pathPts, std::vector<Run>& runs, QueryStats* stats);
+
+    /**
+     * Append the points of the canonical runs, in parallel if there are enough of them
+     * @param runs
+     * @param foundPts
+     * @param limit Maximum number of points to append
+     */
+    void copy_runs(const std::vector<Run>& runs, std::vector<Point>& foundPts, std::size_t limit) const;
+
     /**
      * Search among the tree, find either the successor or predecessor of the given value
      * @param node
      * @param value
      * @param findSucc True if return successor
+     * @param stats Traversal counters, only used if CollectStats
      * @return The successor or predecessor of the given value
      */
-    static FcRangeTreeNode* tree_search(FcRangeTreeNode* node, uint32_t value, bool findSucc);
+    template <bool CollectStats>
+    static Node* tree_search(Node* node, uint32_t value, bool findSucc, QueryStats* stats);
 
     /**
      * Search among the vector, find either the successor or predecessor of the given value
-     * @param node
+     * @param vector
      * @param value
      * @param findSucc True if return successor
-     * @return The successor or predecessor of the given value
+     * @return Index of the successor or predecessor of the given value, or the size of the vector if there is none
      */
-    int vector_search(std::vector<FcNode>& vector, uint32_t value, bool findSucc);
+    static std::size_t vector_search(const std::vector<SecNode>& vector, uint32_t value, bool findSucc);
 
     /**
      * Find the lowest common ancestor of given two tree node.
      * @param node Start root
      * @param succ
      * @param pred
+     * @param stats Traversal counters, only used if CollectStats
      * @return The lowest common ancestor of given two tree node.
      */
-    static FcRangeTreeNode* find_lca(FcRangeTreeNode* node, FcRangeTreeNode* succ, FcRangeTreeNode* pred);
+    template <bool CollectStats>
+    static Node* find_lca(Node* node, Node* succ, Node* pred, QueryStats* stats);
+
+    /**
+     * Walk from lca down to target, carrying the cascaded y-indices, collect path points and canonical runs.
+     * @param lca Lowest common ancestor of the two search paths
+     * @param target Either the successor of x_lower or the predecessor of x_upper
+     * @param query
+     * @param lower Index of the first y >= y_lower in lca's secondary array
+     * @param upper Index of the first y > y_upper in lca's secondary array
+     * @param toSucc True if walking toward the successor of x_lower
+     * @param pathPts Points on the path that are in range
+     * @param runs Canonical runs found along the path
+     * @param stats Traversal counters, only used if CollectStats
+     */
+    template <bool CollectStats>
+    void walk_path(Node* lca, Node* target, Query query, std::size_t lower,
+                   std::size_t upper, bool toSucc, std::vector<Point>& pathPts, std::vector<Run>& runs,
+                   QueryStats* stats);
+
+    /**
+     * Advance the walk by one node, collect the node if it is in range and the canonical run hanging off it
+     * @param walk
+     * @param query
+     * @param pathPts Points on the path that are in range
+     * @param runs Canonical runs found along the path
+     * @param stats Traversal counters, only used if CollectStats
+     * @return False if the walk reached its target or no point below is in the y range
+     */
+    template <bool CollectStats>
+    bool walk_step(PathWalk& walk, Query query, std::vector<Point>& pathPts, std::vector<Run>& runs,
+                   QueryStats* stats);
+
+    /**
+     * Answer count queries in lockstep, see report_points_batch
+     * @param queries
+     * @param results
+     * @param count
+     */
+    void report_points_group(const Query* queries, std::vector<Point>* results, std::size_t count);
 
     /* tree traverse function */
     /**
@@ -69,11 +295,30 @@ private:
      * @param node
      * @param level
      */
-    static void print_tree(FcRangeTreeNode* node, const int level);
+    static void print_tree(Node* node, const int level);
+
+    std::unique_ptr<Node> mRoot{nullptr};
+
+    bool mLazy = false;
+    // points sorted by y, kept until the secondary array of the root is built in lazy mode
+    std::vector<Point> mLazyPoints;
+    std::thread mWarmer;
+    std::atomic<bool> mStopWarming{false};
 
-    std::unique_ptr<FcRangeTreeNode> mRoot{nullptr};
+    SortBackend mSortBackend = SortBackend::Std;
+    std::size_t mLeafSize = 1;
+    std::size_t mQueryThreads = 1;
+    bool mCollapseDuplicates = false;
+    bool mBatchReorder = true;
 };
 
+// instantiated in fc_range_tree.cpp
+extern template class BasicFcRangeTree<uint32_t>;
+extern template class BasicFcRangeTree<PackedIndex40>;
+extern template class BasicFcRangeTree<uint64_t>;
+
+using FcRangeTree = BasicFcRangeTree<uint32_t>;
+
 } // namespace ::Xiuge::RangeTree
 
 #endif //RANGETREE_FD_RANGE_TREE_H
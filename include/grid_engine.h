@@ -0,0 +1,43 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_GRID_ENGINE_H
+#define RANGETREE_GRID_ENGINE_H
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Uniform grid engine, buckets the points into roughly square cells over their bounding box. A query copies the cells
+ * that are fully covered and filters the ones on its border.
+ */
+class GridEngine : public IRangeTree {
+public:
+    void construct_tree(std::vector<Point>& points, bool ) override;
+
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+private:
+    /**
+     * Index of the column/row that a coordinate falls in, coordinate must be within the bounding box
+     * @param value The coordinate
+     * @param min Smallest coordinate of the bounding box in that dimension
+     * @param width Width of a cell in that dimension
+     */
+    uint64_t cell_of(uint32_t value, uint32_t min, uint64_t width) const;
+
+    uint32_t mMinX = 0, mMaxX = 0, mMinY = 0, mMaxY = 0;
+    // number of cells along each side, and the width of each cell
+    uint64_t mCellsPerSide = 0;
+    uint64_t mCellWidthX = 1, mCellWidthY = 1;
+
+    // points of cell c (row major) are mPoints[mCellStart[c], mCellStart[c + 1])
+    std::vector<std::size_t> mCellStart;
+    std::vector<Point> mPoints;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_GRID_ENGINE_H
@@ -0,0 +1,61 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_LATENCY_HISTOGRAM_H
+#define RANGETREE_LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+namespace Xiuge::RangeTree {
+
+/**
+ * HDR-style histogram of latencies. Values below 2^(SUB_BUCKET_BITS + 1) are counted exactly, every larger power of
+ * two range is split into 2^SUB_BUCKET_BITS equal buckets, so any value is reported within a relative error of
+ * 2^-SUB_BUCKET_BITS over the whole 64-bit range, with a fixed memory of a few tens of KB.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned int SUB_BUCKET_BITS = 7;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    /**
+     * Add the counts of another histogram to this one
+     * @param other
+     */
+    void merge(const LatencyHistogram& other);
+
+    void clear();
+
+    /**
+     * @param percentile In [0, 100]
+     * @return The largest value equivalent to the bucket holding the percentile, or 0 if nothing was recorded
+     */
+    uint64_t percentile(double percentile) const;
+
+    uint64_t count() const { return mCount; }
+
+    uint64_t max() const { return mMax; }
+
+    double mean() const;
+
+private:
+    static std::size_t bucket_of(uint64_t value);
+
+    // largest value that falls into the bucket
+    static uint64_t highest_of(std::size_t bucket);
+
+    std::vector<uint64_t> mCounts;
+    uint64_t mCount = 0;
+    uint64_t mMax = 0;
+    // kept in floating point, the sum of many large values may overflow
+    double mSum = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_LATENCY_HISTOGRAM_H
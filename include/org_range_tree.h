@@ -5,92 +5,270 @@
 #ifndef RANGETREE_ORG_RANGE_TREE_H
 #define RANGETREE_ORG_RANGE_TREE_H
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <memory>
+#include <thread>
 
 #include "types.h"
+#include "radix_sort.h"
 
 namespace Xiuge::RangeTree {
 
+/**
+ * Layout of the secondary structure of each node of OrgRangeTree
+ */
+enum class SecondaryLayout {
+    // weighted balance binary search tree on y, reported by in order traversal
+    Tree,
+    // contiguous y-sorted array, reported by a binary search and a range copy
+    Array
+};
+
 /**
  * Implementation of Original Range Tree
  */
-class OrgRangeTree : IRangeTree {
+class OrgRangeTree : public IRangeTree {
 public:
+    ~OrgRangeTree() override;
+
     void construct_tree(std::vector<Point>& points, bool isNaive) override;
 
-    void report_points(Query query, std::vector<Point>& foundPts) override;
+    /**
+     * Select the algorithm of the two pre-sorts in construct_tree
+     * @param backend Either std::sort or the parallel LSD radix sort
+     */
+    void set_sort_backend(SortBackend backend) { mSortBackend = backend; }
+
+    /**
+     * Select the layout of the secondary structures, takes effect on next construct_tree
+     * @param layout Either a tree of trees or a tree of y-sorted arrays
+     */
+    void set_secondary_layout(SecondaryLayout layout) { mSecondaryLayout = layout; }
+
+    /**
+     * Stop the recursion of the first dimension at ranges of at most leafSize points, each becomes a leaf bucket whose
+     * points are stored contiguously and scanned, without secondary trees of their own. Takes effect on next
+     * construct_tree.
+     * @param leafSize 1 for a leaf per point
+     */
+    void set_leaf_size(std::size_t leafSize) {
+        mLeafSize = leafSize > 0 ? std::min<std::size_t>(leafSize, std::numeric_limits<uint32_t>::max()) : 1;
+    }
+
+    /**
+     * Let a single query run the secondary searches of its canonical subtrees on up to numThreads threads of
+     * ThreadPool::shared(), and then copy their answers into the output at prefix offsets in parallel. Meant for
+     * queries with large answers; queries with a limit or with traversal counters stay on the calling thread.
+     * @param numThreads 1 to answer on the calling thread only
+     */
+    void set_query_threads(std::size_t numThreads) { mQueryThreads = numThreads > 0 ? numThreads : 1; }
+
+    /**
+     * In lazy mode construct_tree only builds the primary tree, the secondary tree of a node is built on its first
+     * access, so memory grows only with the part of the tree actually queried. Takes effect on next construct_tree.
+     * @param lazy
+     */
+    void set_lazy(bool lazy) { mLazy = lazy; }
+
+    /**
+     * Build all the secondary trees that are not yet built on a background thread, top down. Only for lazy mode.
+     */
+    void warm_up_async();
+
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+    /**
+     * Same as report_points, and also count how the query traversed the tree
+     * @param query Query that specify the range in each dimension
+     * @param foundPts All points that are in the query range.
+     * @param stats Traversal counters of this query, will be added to
+     * @param limit Maximum number of points to report
+     */
+    void report_points(Query query, std::vector<Point>& foundPts, QueryStats& stats, std::size_t limit = NO_LIMIT);
 
 private:
+    /* coordinate accessor policies of the dimension a tree is ordered by, ties are broken by the remaining fields */
+    struct FirstDim {
+        static constexpr bool IS_PRIMARY = true;
+        using Node = OrgRangeTreePrimaryNode;
+
+        static uint32_t lower(const Query& query) { return query.x_lower; }
+        static uint32_t upper(const Query& query) { return query.x_upper; }
+        static uint32_t coord(const Point& point) { return point.x; }
+
+        // a leaf bucket spans up to its last point
+        static uint32_t max_coord(const Node* node) { return node->maxX; }
+
+        static bool less(const Point& a, const Point& b) { return a < b; }
+    };
+
+    struct SecondDim {
+        static constexpr bool IS_PRIMARY = false;
+        using Node = OrgRangeTreeNode;
+
+        static uint32_t lower(const Query& query) { return query.y_lower; }
+        static uint32_t upper(const Query& query) { return query.y_upper; }
+        static uint32_t coord(const Point& point) { return point.y; }
+        static uint32_t max_coord(const Node* node) { return node->point.y; }
+        static bool less(const Point& a, const Point& b) { return a.y == b.y ? a.id < b.id : a.y < b.y; }
+    };
+
     /* construction helper function */
     /**
      * Naively and recursively build the secondary range tree for the given tree rooted at node, O(n log^2 n) time
      * @param node
      */
-    static void build_sec_dim_naive(OrgRangeTreeNode* node);
+    void build_sec_dim_naive(OrgRangeTreePrimaryNode* node, SecondaryLayout layout);
+
+    /**
+     * Build the secondary structure of a single node from the points of its subtree, O(n log n) time
+     * @param node
+     * @param layout
+     */
+    void build_sec_dim_node(OrgRangeTreePrimaryNode* node, SecondaryLayout layout);
+
+    /**
+     * Make sure the secondary tree of the node is built, a no-op unless in lazy mode. Thread safe.
+     * @param node
+     */
+    void ensure_sec_dim_tree(OrgRangeTreePrimaryNode* node);
+
+    /**
+     * Stop and join the background warm up thread, if there is one
+     */
+    void stop_warm_up();
 
     /**
      * Smartly and recursively build the secondary range tree for the given tree rooted at node, O(n log n) time
      * @param points All points that is in the subtree rooted at node, sorted ascendingly by y.
      * @param node
+     * @param layout
      */
-    static void build_sec_dim_smart(std::vector<Point>& points, OrgRangeTreeNode* node);
+    static void build_sec_dim_smart(std::vector<Point>& points, OrgRangeTreePrimaryNode* node,
+                                    SecondaryLayout layout);
 
     /**
      * Build a weighted balance binary search tree based on a sorted vector of points in O(n) time
+     * @tparam Node Either OrgRangeTreePrimaryNode or OrgRangeTreeNode
      * @param points A vector of points, must be sorted ascedingly.
-     * @param start Start point of the vector.
-     * @param end End point of the vector.
-     * @param dim The dimension that the tree is in
+     * @param begin First point of the vector.
+     * @param end One past the last point of the vector.
+     * @param leafSize Ranges of at most this many points become a leaf bucket, only for OrgRangeTreePrimaryNode
+     * @param buckets The other points of each leaf bucket are appended to it, only for OrgRangeTreePrimaryNode
      * @return A pointer point to the root of the tree.
      */
-    static std::unique_ptr<OrgRangeTreeNode> build_tree(std::vector<Point>& points, const int start, const int end, int dim);
+    template <typename Node>
+    static std::unique_ptr<Node> build_tree(std::vector<Point>& points, std::size_t begin, std::size_t end,
+                                            std::size_t leafSize = 1, std::vector<Point>* buckets = nullptr);
 
     /* range query helper function */
     /**
      * Query along a tree at either first dimension or second dimension, report all nodes that is in query range
+     * @tparam Dim Either FirstDim or SecondDim, the dimension the tree is ordered by
      * @param node Start node, or the root
      * @param points Store all points that are in the query range
      * @param query
-     * @param fstDim True if search along the first dimension
+     * @param maxSize Stop the traversal once points grows to this size
+     * @param stats Traversal counters, compiled out unless CollectStats
+     * @param canonical If given, the canonical subtrees of the first dimension are collected into it instead of
+     *                  being searched
      */
-    void query_tree(OrgRangeTreeNode* node, std::vector<Point>& points, Query query, bool fstDim);
+    template <typename Dim, bool CollectStats>
+    void query_tree(typename Dim::Node* node, std::vector<Point>& points, Query query, std::size_t maxSize,
+                    QueryStats* stats, std::vector<OrgRangeTreePrimaryNode*>* canonical = nullptr);
+
+    /**
+     * Report the points of a canonical subtree hanging off a search path, all of them are in range of Dim
+     * @tparam Dim Either FirstDim or SecondDim, the dimension the tree is ordered by
+     * @param node Root of the canonical subtree
+     * @param points Store all points that are in the query range
+     * @param query
+     * @param maxSize Stop once points grows to this size
+     * @param stats Traversal counters, compiled out unless CollectStats
+     * @param canonical See query_tree
+     */
+    template <typename Dim, bool CollectStats>
+    void report_canonical(typename Dim::Node* node, std::vector<Point>& points, Query query, std::size_t maxSize,
+                          QueryStats* stats, std::vector<OrgRangeTreePrimaryNode*>* canonical);
+
+    /**
+     * Answer the query with the secondary searches and the copy of their answers spread over mQueryThreads threads
+     * @param query
+     * @param foundPts
+     */
+    void report_points_parallel(Query query, std::vector<Point>& foundPts);
+
+    /**
+     * Report the points of the canonical subtree rooted at node whose y-coordinates are in range, from either its
+     * secondary tree or its secondary array
+     * @param node Root of the canonical subtree in the first dimension
+     * @param points Store all points that are in the query range
+     * @param query
+     * @param maxSize Stop once points grows to this size
+     * @param stats Traversal counters, compiled out unless CollectStats
+     */
+    template <bool CollectStats>
+    void query_sec_dim(OrgRangeTreePrimaryNode* node, std::vector<Point>& points, Query query, std::size_t maxSize,
+                       QueryStats* stats);
 
     /**
      * Search among the tree, find either the successor or predecessor of the given value
      * @param node
      * @param value
      * @param findSucc True if return successor
-     * @param fstDim True if search along the first dimension
+     * @param stats Traversal counters, compiled out unless CollectStats
      * @return The successor or predecessor of the given value
      */
-    static OrgRangeTreeNode* tree_search(OrgRangeTreeNode* node, uint32_t value, bool findSucc, bool fstDim);
+    template <typename Dim, bool CollectStats>
+    static typename Dim::Node* tree_search(typename Dim::Node* node, uint32_t value, bool findSucc,
+                                           QueryStats* stats);
 
     /**
      * Find the lowest common ancestor of given two tree node.
      * @param node Start root
      * @param succ
      * @param pred
-     * @param fstDim True if search along the first dimension
+     * @param stats Traversal counters, compiled out unless CollectStats
      * @return The lowest common ancestor of given two tree node.
      */
-    static OrgRangeTreeNode* find_lca(OrgRangeTreeNode* node, OrgRangeTreeNode* succ, OrgRangeTreeNode* pred, bool fstDim);
+    template <typename Dim, bool CollectStats>
+    static typename Dim::Node* find_lca(typename Dim::Node* node, typename Dim::Node* succ, typename Dim::Node* pred,
+                                        QueryStats* stats);
 
     /* tree traverse function */
     /**
      * In order traverse the first dimension of a tree rooted at given node
+     * @tparam Node Either OrgRangeTreePrimaryNode or OrgRangeTreeNode
      * @param points A vector storing the traverse results
      * @param node
+     * @param maxSize Stop the traversal once points grows to this size
      */
-    static void in_order_traverse(OrgRangeTreeNode* node, std::vector<Point>& points);
+    template <typename Node>
+    void in_order_traverse(Node* node, std::vector<Point>& points, std::size_t maxSize = NO_LIMIT) const;
 
     /**
      * Print the tree to stdout, mainly used for debug purpose
+     * @tparam Node Either OrgRangeTreePrimaryNode or OrgRangeTreeNode
      * @param node
      * @param level
      */
-    static void print_tree(OrgRangeTreeNode* node, const int level);
+    template <typename Node>
+    static void print_tree(Node* node, const int level);
+
+    std::unique_ptr<OrgRangeTreePrimaryNode> mRoot{nullptr};
+    // the other points of all leaf buckets, each bucket is contiguous
+    std::vector<Point> mBuckets;
+
+    bool mLazy = false;
+    std::thread mWarmer;
+    std::atomic<bool> mStopWarming{false};
 
-    std::unique_ptr<OrgRangeTreeNode> mRoot{nullptr};
+    SortBackend mSortBackend = SortBackend::Std;
+    SecondaryLayout mSecondaryLayout = SecondaryLayout::Tree;
+    std::size_t mLeafSize = 1;
+    std::size_t mQueryThreads = 1;
 };
 
 } // namespace ::Xiuge::RangeTree
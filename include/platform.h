@@ -0,0 +1,95 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_PLATFORM_H
+#define RANGETREE_PLATFORM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Xiuge::RangeTree {
+
+// CPU layout and cache sizes of the machine, a field is 0 or empty if it could not be read
+struct PlatformInfo {
+    std::string cpuModel;
+    std::size_t logicalCpus = 0;
+    std::size_t physicalCores = 0;
+    std::size_t packages = 0;
+
+    // in bytes
+    std::size_t l1dCacheSize = 0;
+    std::size_t l2CacheSize = 0;
+    std::size_t llcSize = 0;
+};
+
+/**
+ * Read the CPU layout from sysfs and /proc/cpuinfo
+ * @return
+ */
+PlatformInfo platform_info();
+
+/**
+ * @param cpu
+ * @return Current frequency of the cpu in MHz, or 0 if it could not be read
+ */
+double cpu_frequency_mhz(std::size_t cpu);
+
+/**
+ * Pin the calling thread to a single CPU, so that it does not migrate away from its warm caches
+ * @param cpu
+ * @return False if pinning is not supported or the cpu is not available
+ */
+bool pin_current_thread(std::size_t cpu);
+
+/**
+ * Pin the calling thread to a single CPU for the lifetime of the object, then restore the CPUs it was allowed to run
+ * on before. Threads inherit the CPUs of the thread creating them, so no thread should be spawned while pinned, nor a
+ * lazily created pool such as ThreadPool::shared() be used for the first time.
+ */
+class ThreadPin {
+public:
+    /**
+     * @param cpu
+     */
+    explicit ThreadPin(std::size_t cpu);
+
+    ~ThreadPin();
+
+    ThreadPin(const ThreadPin&) = delete;
+    ThreadPin& operator=(const ThreadPin&) = delete;
+
+    /**
+     * @return False if pinning is not supported or the cpu is not available, the thread is then left as it was
+     */
+    bool pinned() const { return mPinned; }
+
+private:
+    // CPUs the thread was allowed to run on before
+    std::vector<std::size_t> mSavedCpus;
+    bool mPinned = false;
+};
+
+/**
+ * Evicts the data caches by streaming a buffer several times the size of the last level cache through them, so that
+ * the next operation starts cold
+ */
+class CacheFlusher {
+public:
+    /**
+     * @param llcSize Size of the last level cache in bytes, a default is assumed if 0
+     * @param factor Size of the buffer in multiples of llcSize
+     */
+    explicit CacheFlusher(std::size_t llcSize, std::size_t factor = 2);
+
+    void flush();
+
+private:
+    std::vector<uint64_t> mBuffer;
+    uint64_t mSink = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_PLATFORM_H
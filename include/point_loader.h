@@ -0,0 +1,59 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_POINT_LOADER_H
+#define RANGETREE_POINT_LOADER_H
+
+#include <string>
+#include <thread>
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Bulk loader of point files, produces points in the form construct_tree takes. Two formats are supported:
+ *   CSV: one "id,x,y" per line of unsigned integers, an optional header line is skipped.
+ *   Binary: little-endian columnar, a 16 bytes header (magic "RTPT", uint32 version, uint64 n) followed by the
+ *           columns id[n], x[n] and y[n], each being uint32.
+ */
+class PointLoader {
+public:
+    /**
+     * @param numThreads Number of chunks a CSV file is split into and parsed in parallel on ThreadPool::shared(),
+     *                   default as the number of hardware threads
+     */
+    explicit PointLoader(std::size_t numThreads = std::thread::hardware_concurrency());
+
+    /**
+     * Parse a CSV file in parallel chunks split at line boundaries
+     * @param path
+     * @return Points in the order of the file
+     */
+    std::vector<Point> load_csv(const std::string& path);
+
+    /**
+     * Read a binary columnar file through mmap
+     * @param path
+     * @return Points in the order of the file
+     */
+    std::vector<Point> load_binary(const std::string& path);
+
+    static void save_csv(const std::string& path, const std::vector<Point>& points);
+
+    static void save_binary(const std::string& path, const std::vector<Point>& points);
+
+    /**
+     * @return Ingest throughput of the last load in MB/s
+     */
+    double last_throughput() const { return mLastThroughput; }
+
+private:
+    std::size_t mNumThreads;
+    double mLastThroughput = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_POINT_LOADER_H
@@ -0,0 +1,116 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_QUERY_PLANNER_H
+#define RANGETREE_QUERY_PLANNER_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "fc_range_tree.h"
+#include "org_range_tree.h"
+#include "scan_engine.h"
+#include "grid_engine.h"
+
+namespace Xiuge::RangeTree {
+
+// Engines that the planner could route a query to
+enum class QueryEngine {
+    FractionalCascading = 0,
+    Original,
+    Scan,
+    Grid
+};
+
+const std::size_t NUM_QUERY_ENGINES = 4;
+
+std::string to_string(QueryEngine engine);
+
+// Linear cost model of an engine, predicted running time (ns) = fixed + perPoint * k
+struct EngineCost {
+    double fixed = 0;
+    double perPoint = 0;
+};
+
+// A routing decision made by the planner
+struct PlanChoice {
+    Query query;
+    std::size_t estimatedK;
+    QueryEngine engine;
+    double predictedCost;
+};
+
+/**
+ * Selectivity-aware query planner, estimates the output size k of a query in O(log n) time by counting over the
+ * fractional cascading indices, and then routes the query to the engine with the lowest predicted cost. The cost model
+ * is calibrated by a short micro-benchmark right after construction.
+ */
+class QueryPlanner : public IRangeTree {
+public:
+    // number of the most recent routing decisions kept for get_choices
+    static constexpr std::size_t MAX_RECORDED_CHOICES = 4096;
+
+    void construct_tree(std::vector<Point>& points, bool isNaive) override;
+
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+    /**
+     * Estimate the number of points in the query range
+     * @param query
+     * @return Estimated output size
+     */
+    std::size_t estimate_output_size(Query query);
+
+    /**
+     * Pick the engine with lowest predicted cost for a query with the given output size
+     * @param k Estimated output size
+     * @return The cheapest engine
+     */
+    QueryEngine choose_engine(std::size_t k) const;
+
+    /**
+     * Time every engine on queries of various selectivity and fit the cost model of each of them
+     * @param points Points the engines are built on
+     */
+    void calibrate(const std::vector<Point>& points);
+
+    const std::array<EngineCost, NUM_QUERY_ENGINES>& get_costs() const { return mCosts; }
+
+    /**
+     * @return Up to MAX_RECORDED_CHOICES most recent routing decisions since the last clear_choices, oldest first
+     */
+    std::vector<PlanChoice> get_choices() const;
+
+    void clear_choices();
+
+    /**
+     * @return Number of queries each engine answered since the last clear_choices, including the ones no longer kept
+     *         by get_choices
+     */
+    std::array<std::size_t, NUM_QUERY_ENGINES> engine_usage() const;
+
+private:
+    IRangeTree& engine(QueryEngine engine);
+
+    FcRangeTree mFcRangeTree;
+    OrgRangeTree mOrgRangeTree;
+    ScanEngine mScanEngine;
+    GridEngine mGridEngine;
+
+    std::array<EngineCost, NUM_QUERY_ENGINES> mCosts;
+
+    // report_points may be called concurrently, the usage is counted without locking and only a bounded ring of the
+    // recent choices is kept under the mutex
+    std::array<std::atomic<std::size_t>, NUM_QUERY_ENGINES> mUsage{};
+    mutable std::mutex mChoicesMutex;
+    std::vector<PlanChoice> mChoices;
+    // number of choices recorded since the last clear_choices, the next one overwrites mChoices[mNumChoices % size]
+    std::size_t mNumChoices = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_QUERY_PLANNER_H
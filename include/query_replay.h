@@ -0,0 +1,124 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_QUERY_REPLAY_H
+#define RANGETREE_QUERY_REPLAY_H
+
+#include <string>
+#include <thread>
+
+#include "data_generator.h"
+#include "latency_histogram.h"
+#include "thread_pool.h"
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+// A query of a trace, with its arrival time relative to the start of the trace
+struct TracedQuery {
+    uint64_t timestampNs;
+    Query query;
+};
+
+/**
+ * Timestamped sequence of queries. The file is little-endian, a 16 bytes header (magic "RTQT", uint32 version,
+ * uint64 n) followed by n records, each being the LEB128 varints of the time since the previous query in ns, x_lower,
+ * x_upper - x_lower, y_lower and y_upper - y_lower, so a typical query takes about 12 bytes.
+ */
+class QueryTrace {
+public:
+    /**
+     * Append a query arriving now, not thread safe
+     * @param query
+     */
+    void record(Query query);
+
+    /**
+     * Append a query, timestamps must not decrease
+     * @param query
+     * @param timestampNs Arrival time relative to the start of the trace
+     */
+    void record(Query query, uint64_t timestampNs);
+
+    /**
+     * Draw queries of the given range from the generator, arriving as a Poisson process
+     * @param generator
+     * @param numQueries
+     * @param range Query range, see DataGenerator::generate_a_query
+     * @param qps Average arrival rate
+     * @param seed Seed of the inter-arrival times
+     */
+    static QueryTrace generate(DataGenerator& generator, std::size_t numQueries, uint32_t range, double qps,
+                               uint32_t seed = 1);
+
+    void save(const std::string& path) const;
+
+    static QueryTrace load(const std::string& path);
+
+    const std::vector<TracedQuery>& queries() const { return mQueries; }
+
+    std::size_t size() const { return mQueries.size(); }
+
+    /**
+     * @return Average arrival rate of the trace, 0 if it spans no time
+     */
+    double qps() const;
+
+private:
+    std::vector<TracedQuery> mQueries;
+    // steady clock time of the first record(query), in ns
+    long long int mStartNs = -1;
+};
+
+// Outcome of one open-loop replay
+struct ReplayResult {
+    double offeredQps = 0;
+    double achievedQps = 0;
+    // from the scheduled arrival of each query to its completion in ns, so queueing delay is included
+    LatencyHistogram latency;
+};
+
+/**
+ * Open-loop load generator. The calling thread releases the queries of a trace at their arrival times, scaled to a
+ * target rate, onto a pool of worker threads, regardless of whether the earlier ones have completed. The latency of a
+ * query is measured from its scheduled arrival rather than from its actual start, so a saturated engine shows up as
+ * growing queueing delay instead of a silently lowered rate.
+ */
+class QueryReplayer {
+public:
+    /**
+     * @param tree Engine under test, must be constructed and must answer concurrent queries
+     * @param numWorkers Number of worker threads answering the queries
+     */
+    explicit QueryReplayer(IRangeTree& tree, std::size_t numWorkers = std::thread::hardware_concurrency());
+
+    /**
+     * @param trace
+     * @param qps Target rate, the arrival times are scaled to it, 0 to keep the arrival times of the trace
+     * @return Latency histogram and rates of the replay
+     */
+    ReplayResult replay(const QueryTrace& trace, double qps = 0);
+
+    /**
+     * Find the highest rate at which the given percentile of latency stays within the target and the replay keeps up
+     * with the rate. The rate is doubled until the target is missed, then bisected between the last rate that met it
+     * and the first that did not.
+     * @param trace
+     * @param percentile In [0, 100], e.g. 99
+     * @param targetNs Latency target in ns
+     * @param startQps First rate tried
+     * @param numBisections Number of replays spent on bisection
+     * @return The highest rate found to meet the target, 0 if even startQps misses it
+     */
+    double max_sustainable_qps(const QueryTrace& trace, double percentile, uint64_t targetNs, double startQps,
+                               std::size_t numBisections = 6);
+
+private:
+    IRangeTree& mTree;
+    ThreadPool mPool;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_QUERY_REPLAY_H
@@ -0,0 +1,52 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_RADIX_SORT_H
+#define RANGETREE_RADIX_SORT_H
+
+#include <thread>
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+// Sorting algorithm used by construct_tree for its pre-sorts
+enum class SortBackend {
+    Std,
+    Radix
+};
+
+/**
+ * Sort points ascendingly by x, and then by y, break tie by id
+ * @param points Points to be sorted in-place
+ * @param backend Either std::sort or the parallel LSD radix sort
+ * @param buffer Scratch space of the radix sort, will be resized to the size of points and could be reused
+ * @param numThreads Number of threads used by the radix sort
+ */
+void sort_by_x(std::vector<Point>& points, SortBackend backend, std::vector<Point>& buffer,
+               std::size_t numThreads = std::thread::hardware_concurrency());
+
+/**
+ * Sort points ascendingly by y, break tie by id
+ * @param points Points to be sorted in-place
+ * @param backend Either std::sort or the parallel LSD radix sort
+ * @param buffer Scratch space of the radix sort, will be resized to the size of points and could be reused
+ * @param numThreads Number of threads used by the radix sort
+ */
+void sort_by_y(std::vector<Point>& points, SortBackend backend, std::vector<Point>& buffer,
+               std::size_t numThreads = std::thread::hardware_concurrency());
+
+/**
+ * Parallel LSD radix sort, stable on every key, the least significant key goes first
+ * @param points Points to be sorted in-place
+ * @param buffer Scratch space, points are scattered back and forth between points and buffer
+ * @param keys Fields of Point to sort on, from the least significant to the most significant
+ * @param numThreads Number of threads
+ */
+void radix_sort(std::vector<Point>& points, std::vector<Point>& buffer, const std::vector<uint32_t Point::*>& keys,
+                std::size_t numThreads);
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_RADIX_SORT_H
@@ -0,0 +1,217 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_RANGE_AGGREGATOR_H
+#define RANGETREE_RANGE_AGGREGATOR_H
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fc_range_tree.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Associative operations over point weights. An operation provides value_type, identity() and combine(a, b), and
+ * optionally inverse(a, b) that undoes combining b into a.
+ */
+template <typename T>
+struct SumOp {
+    using value_type = T;
+
+    static constexpr T identity() { return T{}; }
+
+    static constexpr T combine(T a, T b) { return a + b; }
+
+    static constexpr T inverse(T a, T b) { return a - b; }
+};
+
+template <typename T>
+struct MinOp {
+    using value_type = T;
+
+    static constexpr T identity() { return std::numeric_limits<T>::max(); }
+
+    static constexpr T combine(T a, T b) { return std::min(a, b); }
+};
+
+template <typename T>
+struct MaxOp {
+    using value_type = T;
+
+    static constexpr T identity() { return std::numeric_limits<T>::lowest(); }
+
+    static constexpr T combine(T a, T b) { return std::max(a, b); }
+};
+
+// operations with an inverse are answered from prefix aggregates, the others from block sparse tables
+template <typename Op>
+concept InvertibleOp = requires(typename Op::value_type a) {
+    { Op::inverse(a, a) } -> std::convertible_to<typename Op::value_type>;
+};
+
+/**
+ * Aggregate of the weights of all points in a query range over a fractional cascading range tree, without enumerating
+ * the points. Each node's y-sorted secondary array gets either prefix aggregates, if Op is invertible, or in-block
+ * prefix/suffix aggregates plus a sparse table over blocks, which requires Op to be idempotent (min, max...). A query
+ * combines the O(log n) path points and canonical runs, each run in O(1), so it takes O(log n) time.
+ * @tparam Op Associative operation, e.g. SumOp, MinOp or MaxOp
+ */
+template <typename Op>
+class RangeAggregator {
+public:
+    using value_type = typename Op::value_type;
+
+    /**
+     * @param tree The tree must be constructed before build and must not be reconstructed while in use
+     */
+    explicit RangeAggregator(FcRangeTree& tree) : mTree(tree) {}
+
+    /**
+     * Build the per-node tables, both of them take O(n log n) space in total
+     * @param weights Weight of each point, indexed by point id
+     */
+    void build(std::vector<value_type> weights) {
+        mWeights = std::move(weights);
+        mTables.clear();
+
+        mTree.for_each_node([this](const FcRangeTreeNode* node) {
+            if (node->index >= mTables.size())
+                mTables.resize(node->index + 1);
+
+            auto& table = mTables[node->index];
+            const auto& secFCNodes = node->secFCNodes;
+            std::size_t len = secFCNodes.size();
+
+            if constexpr (InvertibleOp<Op>) {
+                // table[i] aggregates secFCNodes[0, i)
+                table.resize(len + 1);
+                table[0] = Op::identity();
+
+                for (std::size_t i = 0; i < len; ++i)
+                    table[i + 1] = Op::combine(table[i], weight_of(secFCNodes[i].point));
+            }
+            else {
+                // in-block prefix aggregates, then in-block suffix aggregates, then the sparse table over blocks
+                std::size_t numBlocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+                auto levels = static_cast<std::size_t>(std::bit_width(numBlocks));
+                table.resize(2 * len + levels * numBlocks);
+
+                value_type* prefix = table.data();
+                value_type* suffix = prefix + len;
+                value_type* blocks = suffix + len;
+
+                for (std::size_t i = 0; i < len; ++i) {
+                    value_type weight = weight_of(secFCNodes[i].point);
+                    prefix[i] = i % BLOCK_SIZE == 0 ? weight : Op::combine(prefix[i - 1], weight);
+                }
+
+                for (std::size_t i = len; i-- > 0;) {
+                    value_type weight = weight_of(secFCNodes[i].point);
+                    suffix[i] = (i + 1) % BLOCK_SIZE == 0 || i + 1 == len ? weight : Op::combine(weight, suffix[i + 1]);
+                }
+
+                // level l aggregates blocks [i, i + 2^l), levels are stored one after another
+                for (std::size_t b = 0; b < numBlocks; ++b)
+                    blocks[b] = suffix[b * BLOCK_SIZE];
+
+                for (std::size_t l = 1; l < levels; ++l) {
+                    std::size_t half = std::size_t{1} << (l - 1);
+
+                    for (std::size_t b = 0; b + 2 * half <= numBlocks; ++b) {
+                        blocks[l * numBlocks + b] = Op::combine(blocks[(l - 1) * numBlocks + b],
+                                                                blocks[(l - 1) * numBlocks + b + half]);
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @param query Query that specify the range in each dimension
+     * @return Aggregate of the weights of the points in the query range, Op::identity() if there is none
+     */
+    value_type aggregate(Query query) {
+        std::vector<Point> pathPts;
+        std::vector<FcRun> runs;
+        mTree.find_canonical(query, pathPts, runs);
+
+        value_type result = Op::identity();
+
+        for (auto& point : pathPts)
+            result = Op::combine(result, weight_of(point));
+
+        for (auto& run : runs)
+            result = Op::combine(result, run_aggregate(run));
+
+        return result;
+    }
+
+private:
+    value_type weight_of(const Point& point) const {
+        if (unlikely(point.id >= mWeights.size()))
+            throw std::runtime_error("[RangeAggregator] no weight for point id " + std::to_string(point.id));
+
+        return mWeights[point.id];
+    }
+
+    // aggregate of secFCNodes[begin, end) of the run's node, the run is never empty
+    value_type run_aggregate(const FcRun& run) const {
+        const auto& table = mTables[run.node->index];
+
+        if constexpr (InvertibleOp<Op>) {
+            return Op::inverse(table[run.end], table[run.begin]);
+        }
+        else {
+            const auto& secFCNodes = run.node->secFCNodes;
+            std::size_t len = secFCNodes.size(), numBlocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            std::size_t last = run.end - 1;
+            std::size_t firstBlock = run.begin / BLOCK_SIZE, lastBlock = last / BLOCK_SIZE;
+
+            // a run within one block is short, fold it directly
+            if (firstBlock == lastBlock) {
+                value_type result = weight_of(secFCNodes[run.begin].point);
+
+                for (std::size_t i = run.begin + 1; i <= last; ++i)
+                    result = Op::combine(result, weight_of(secFCNodes[i].point));
+
+                return result;
+            }
+
+            const value_type* prefix = table.data();
+            const value_type* suffix = prefix + len;
+            const value_type* blocks = suffix + len;
+
+            value_type result = Op::combine(suffix[run.begin], prefix[last]);
+
+            if (lastBlock - firstBlock > 1) {
+                std::size_t count = lastBlock - firstBlock - 1;
+                auto l = static_cast<std::size_t>(std::bit_width(count) - 1);
+
+                result = Op::combine(result, Op::combine(blocks[l * numBlocks + firstBlock + 1],
+                                                         blocks[l * numBlocks + lastBlock - (std::size_t{1} << l)]));
+            }
+
+            return result;
+        }
+    }
+
+    // number of consecutive points covered by an in-block prefix or suffix aggregate
+    static constexpr std::size_t BLOCK_SIZE = 16;
+
+    FcRangeTree& mTree;
+    std::vector<value_type> mWeights;
+    // per-node table, indexed by FcRangeTreeNode::index
+    std::vector<std::vector<value_type>> mTables;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_RANGE_AGGREGATOR_H
@@ -0,0 +1,75 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_SCAN_ENGINE_H
+#define RANGETREE_SCAN_ENGINE_H
+
+#include <string>
+
+#include "types.h"
+
+namespace Xiuge::RangeTree {
+
+// Instruction set of the scan kernel
+enum class ScanKernel {
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+std::string to_string(ScanKernel kernel);
+
+/**
+ * Brute-force engine, stores points as separate id/x/y columns and answers a query with one linear pass over them.
+ * The pass compares a whole vector of x and y per instruction and compresses the indices of the matches, with the
+ * widest kernel the CPU supports picked at runtime. It could also split the columns into slices scanned in parallel.
+ */
+class ScanEngine : public IRangeTree {
+public:
+    /**
+     * @param numThreads Number of slices of the columns scanned in parallel on ThreadPool::shared(), 1 for a
+     *                   single-threaded scan
+     */
+    explicit ScanEngine(std::size_t numThreads = 1);
+
+    void construct_tree(std::vector<Point>& points, bool ) override;
+
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+    /**
+     * Override the kernel picked at runtime, mainly used to compare the kernels
+     * @param kernel Must be supported by the CPU
+     */
+    void set_kernel(ScanKernel kernel);
+
+    ScanKernel kernel() const { return mKernel; }
+
+    /**
+     * @return The widest kernel supported by the CPU
+     */
+    static ScanKernel best_kernel();
+
+private:
+    /**
+     * Scan the points [begin, end) of the columns
+     * @param begin
+     * @param end
+     * @param query
+     * @param foundPts Points in range are appended to it
+     * @param limit Maximum number of points to report
+     */
+    void scan_range(std::size_t begin, std::size_t end, Query query, std::vector<Point>& foundPts,
+                    std::size_t limit) const;
+
+    std::size_t mNumThreads;
+    ScanKernel mKernel;
+
+    std::vector<uint32_t> mIds;
+    std::vector<uint32_t> mXs;
+    std::vector<uint32_t> mYs;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_SCAN_ENGINE_H
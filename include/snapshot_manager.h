@@ -0,0 +1,97 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_SNAPSHOT_MANAGER_H
+#define RANGETREE_SNAPSHOT_MANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "fc_range_tree.h"
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Read-copy-update publication of fractional cascading range trees. Readers pin the current snapshot by an atomic load
+ * of a reference-counted pointer, never waiting for a rebuild. A rebuild constructs a new tree from a copy of the
+ * points off to the side and swaps it in atomically; the replaced snapshot stays valid for the readers still holding
+ * it. Whichever thread drops its last reference only hands the tree to a reclaimer thread, which destroys it, so no
+ * reader pays for the destruction and no writer waits for the readers.
+ *
+ * libstdc++ implements std::atomic<std::shared_ptr> with a spin lock in the low bit of the pointer, held by acquire
+ * and by the publishing exchange just long enough to copy the pointer and bump the reference count, so readers never
+ * block on a rebuild but are not lock-free in the strict sense.
+ */
+class SnapshotManager : public IRangeTree {
+public:
+    using Snapshot = std::shared_ptr<FcRangeTree>;
+
+    SnapshotManager();
+
+    ~SnapshotManager() override;
+
+    /**
+     * Build a snapshot from the points after the pending background rebuilds and publish it before returning
+     * @param points
+     * @param isNaive
+     */
+    void construct_tree(std::vector<Point>& points, bool isNaive) override;
+
+    /**
+     * Query the snapshot that is current at the time of the call
+     */
+    void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) override;
+
+    /**
+     * Build a snapshot from the points on a background thread and publish it once it is complete. Returns without
+     * waiting, the rebuilds run one after another and publish in the order they were requested.
+     * @param points
+     */
+    void rebuild_async(std::vector<Point> points);
+
+    /**
+     * Block until the rebuilds requested before the call have published their snapshots
+     */
+    void wait_rebuild();
+
+    /**
+     * Pin the current snapshot, it stays valid as long as the returned pointer is held
+     * @return The current snapshot, or nullptr if nothing was published yet
+     */
+    Snapshot acquire() const { return mCurrent.load(std::memory_order_acquire); }
+
+    /**
+     * @return Number of snapshots published so far
+     */
+    uint64_t version() const { return mVersion.load(std::memory_order_acquire); }
+
+private:
+    class Reclaimer;
+
+    /**
+     * Build a new tree from the points and publish it, the replaced snapshot is retired by its last reader
+     * @param points
+     */
+    void rebuild(std::vector<Point>& points);
+
+    std::atomic<Snapshot> mCurrent;
+    std::atomic<uint64_t> mVersion{0};
+    // also held by the deleter of every published snapshot, so it outlives the snapshots pinned past the manager
+    std::shared_ptr<Reclaimer> mReclaimer;
+
+    // guards the fields below, readers never take it and nobody waits for a rebuild while holding it
+    std::mutex mRebuildMutex;
+    std::condition_variable mRebuildDone;
+    // the latest background rebuild, each of them joins the previous one before it starts
+    std::thread mRebuilder;
+    uint64_t mNumRequested = 0;
+    uint64_t mNumCompleted = 0;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_SNAPSHOT_MANAGER_H
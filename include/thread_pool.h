@@ -0,0 +1,66 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_THREAD_POOL_H
+#define RANGETREE_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Xiuge::RangeTree {
+
+/**
+ * A fixed size pool of worker threads executing submitted tasks in FIFO order
+ */
+class ThreadPool {
+public:
+    /**
+     * @param numThreads Number of worker threads, default as the number of hardware threads
+     */
+    explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency());
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Enqueue a task, it will be run by one of the workers
+     * @param task
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Run fn(0), ..., fn(num - 1) and wait for all of them, fn(0) runs on the calling thread and the others on the
+     * workers. Called from one of this pool's workers, everything runs on the calling thread instead, so a task never
+     * waits for a worker that may be waiting for it.
+     * @param num
+     * @param fn
+     */
+    void parallel_for(std::size_t num, const std::function<void(std::size_t)>& fn);
+
+    std::size_t size() const { return mWorkers.size(); }
+
+    /**
+     * @return The executor shared by the whole process
+     */
+    static ThreadPool& shared();
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> mWorkers;
+    std::queue<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_THREAD_POOL_H
@@ -0,0 +1,137 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#ifndef RANGETREE_TRACER_H
+#define RANGETREE_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Xiuge::RangeTree {
+
+/**
+ * Process wide collector of timed phases. Every thread records into its own ring buffer without locking, the oldest
+ * events of a thread are overwritten once its ring is full. The ring of an exited thread keeps its events and is
+ * handed to the next thread that starts recording, so the memory is bounded by the largest number of threads that
+ * recorded at the same time rather than by the number of threads ever spawned. Recording is switched on and off at
+ * runtime, when off a TraceScope costs a single relaxed load. The collected events are exported in the Chrome trace
+ * event format, which both chrome://tracing and Perfetto open.
+ */
+class Tracer {
+public:
+    // number of events kept per thread
+    static constexpr std::size_t RING_CAPACITY = 1 << 16;
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @return The tracer shared by the whole process
+     */
+    static Tracer& shared();
+
+    void set_enabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+    bool enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Record a phase of the calling thread
+     * @param name Must outlive the tracer, usually a string literal
+     * @param beginNs Start time from now_ns()
+     * @param endNs End time from now_ns()
+     */
+    void record(const char* name, int64_t beginNs, int64_t endNs);
+
+    /**
+     * Drop every event recorded so far, may run concurrently with traced work
+     */
+    void clear();
+
+    /**
+     * Write the recorded events as Chrome trace JSON. May run concurrently with traced work, the events completed
+     * before the call are written unless their slot is overwritten meanwhile, those are skipped.
+     * @param out
+     */
+    void write_chrome_json(std::ostream& out) const;
+
+    /**
+     * Write the recorded events as Chrome trace JSON to a file, see write_chrome_json
+     * @param path
+     */
+    void dump_chrome_json(const std::string& path) const;
+
+    /**
+     * @return Monotonic time in nanoseconds
+     */
+    static int64_t now_ns();
+
+private:
+    // fields are relaxed atomics so that an export may read a slot while its thread overwrites it
+    struct Event {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<int64_t> beginNs{0};
+        std::atomic<int64_t> endNs{0};
+    };
+
+    // ring of a single thread at a time, owned by the tracer so that it outlives the thread until dumped
+    struct Ring {
+        std::size_t tid;
+        std::unique_ptr<Event[]> events{new Event[RING_CAPACITY]};
+        // events [0, written) are complete, published with release
+        std::atomic<std::size_t> written{0};
+        // number of events whose slot was claimed, the slot of event i is being overwritten once it exceeds
+        // i + RING_CAPACITY
+        std::atomic<std::size_t> claimed{0};
+        // events before it were dropped by clear
+        std::atomic<std::size_t> cleared{0};
+    };
+
+    Tracer() = default;
+
+    /**
+     * @return Ring of the calling thread, taken from the rings of exited threads or registered on first use
+     */
+    Ring& local_ring();
+
+    std::atomic<bool> mEnabled{false};
+
+    // guards mRings and mFreeRings, the rings themselves are only written by their threads
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<Ring>> mRings;
+    // rings of exited threads, reused before registering new ones
+    std::vector<Ring*> mFreeRings;
+};
+
+/**
+ * Record the lifetime of the scope as a phase of the calling thread, if tracing is enabled when it begins
+ */
+class TraceScope {
+public:
+    /**
+     * @param name Must outlive the tracer, usually a string literal
+     */
+    explicit TraceScope(const char* name)
+            : mName(name), mBeginNs(Tracer::shared().enabled() ? Tracer::now_ns() : -1) {}
+
+    ~TraceScope() {
+        if (mBeginNs >= 0)
+            Tracer::shared().record(mName, mBeginNs, Tracer::now_ns());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* mName;
+    int64_t mBeginNs;
+};
+
+} // namespace ::Xiuge::RangeTree
+
+#endif //RANGETREE_TRACER_H
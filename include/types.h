@@ -6,11 +6,16 @@
 #define RANGETREE_TYPES_H
 
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace Xiuge::RangeTree {
 
+// Limit of a query that reports every point in range
+const std::size_t NO_LIMIT = std::numeric_limits<std::size_t>::max();
+
 // A point in two dimensional space
 struct Point {
     Point(uint32_t new_x, uint32_t new_y) {
@@ -79,52 +84,161 @@ struct Query {
     uint32_t y_upper = 0;
 };
 
-// fractional cascading node
-struct FcNode {
-    FcNode(Point newPoint) {
+// Traversal counters of a single query, only filled by the instrumented overload of report_points
+struct QueryStats {
+    // primary (first dimension) tree nodes visited
+    std::size_t primaryNodes = 0;
+    // fractional cascading pointers followed
+    std::size_t cascadeHops = 0;
+    // canonical subtrees reported
+    std::size_t canonicalSubtrees = 0;
+    // searches run on secondary structures
+    std::size_t secondarySearches = 0;
+    // points on the search paths rejected by the range check
+    std::size_t rangeRejections = 0;
+
+    QueryStats& operator+=(const QueryStats& other) {
+        primaryNodes += other.primaryNodes;
+        cascadeHops += other.cascadeHops;
+        canonicalSubtrees += other.canonicalSubtrees;
+        secondarySearches += other.secondarySearches;
+        rangeRejections += other.rangeRejections;
+        return *this;
+    }
+};
+
+// Index of 40 bits packed into 5 bytes, addresses up to 2^40 points in less memory than a 64-bit index
+struct PackedIndex40 {
+    static constexpr uint64_t MAX = (uint64_t{1} << 40) - 1;
+
+    PackedIndex40() = default;
+
+    PackedIndex40(uint64_t value) {
+        for (std::size_t i = 0; i < sizeof(bytes); ++i)
+            bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    operator uint64_t() const {
+        uint64_t value = 0;
+        for (std::size_t i = 0; i < sizeof(bytes); ++i)
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+
+        return value;
+    }
+
+    uint8_t bytes[5] = {};
+};
+
+// Largest value an index type of the fractional cascading range tree could hold
+template <typename Index>
+constexpr uint64_t max_index() {
+    if constexpr (std::numeric_limits<Index>::is_integer)
+        return std::numeric_limits<Index>::max();
+    else
+        return Index::MAX;
+}
+
+// fractional cascading node, successors index into the children's secondary arrays
+template <typename Index>
+struct BasicFcNode {
+    BasicFcNode(Point newPoint) {
         point = newPoint;
     }
 
     Point point;
 
-    int32_t successor_left = -1;
-    int32_t successor_right = -1;
+    Index successor_left{};
+    Index successor_right{};
 };
 
+// node of a tree ordered by y, the secondary structure of a primary node of the original range tree
 struct OrgRangeTreeNode {
-    OrgRangeTreeNode(Point newPoint, int newDimension) {
+    OrgRangeTreeNode(Point newPoint) {
         point = newPoint;
-        dimension = newDimension;
     }
 
     Point point;
-    int dimension;
 
     std::unique_ptr<OrgRangeTreeNode> left{ nullptr };
     std::unique_ptr<OrgRangeTreeNode> right{ nullptr };
 
+    OrgRangeTreeNode* parent{ nullptr };
+};
+
+// node of the primary tree of the original range tree, ordered by x, holds the secondary structure of its subtree
+struct OrgRangeTreePrimaryNode {
+    OrgRangeTreePrimaryNode(Point newPoint) {
+        point = newPoint;
+        maxX = newPoint.x;
+    }
+
+    Point point;
+    // guards the on-demand construction of nextDimRoot or nextDimArray in lazy mode, kept next to point to fill its
+    // padding
+    std::once_flag nextDimOnce;
+
+    // largest x-coordinate of the node, the one of the last point of a leaf bucket
+    uint32_t maxX;
+    // the other points of a leaf bucket, ascendingly after point, are bucketSize points of the buckets array of the
+    // tree starting at bucketBegin, scanned instead of descending
+    uint32_t bucketSize{ 0 };
+    std::size_t bucketBegin{ 0 };
+
+    std::unique_ptr<OrgRangeTreePrimaryNode> left{ nullptr };
+    std::unique_ptr<OrgRangeTreePrimaryNode> right{ nullptr };
+
     std::unique_ptr<OrgRangeTreeNode> nextDimRoot{ nullptr };
+    // points of the subtree sorted by y, replaces nextDimRoot in the array secondary layout
+    std::vector<Point> nextDimArray;
 
-    OrgRangeTreeNode* parent{ nullptr };
+    OrgRangeTreePrimaryNode* parent{ nullptr };
 };
 
-struct FcRangeTreeNode {
-    FcRangeTreeNode(Point newPoint) {
+template <typename Index>
+struct BasicFcRangeTreeNode {
+    BasicFcRangeTreeNode(Point newPoint) {
         point = newPoint;
     }
 
     Point point;
+    // rank of the point in the x-sorted order, unique among the nodes of a tree, the nodes of a leaf bucket or of a
+    // collapsed x-coordinate take the ranks up to the next node
+    Index index{};
+    // largest x-coordinate of a leaf bucket, whose point is its smallest one, or the x-coordinate of point otherwise
+    uint32_t maxX = 0;
 
-    std::unique_ptr<FcRangeTreeNode> left{ nullptr };
-    std::unique_ptr<FcRangeTreeNode> right{ nullptr };
+    std::unique_ptr<BasicFcRangeTreeNode> left{ nullptr };
+    std::unique_ptr<BasicFcRangeTreeNode> right{ nullptr };
 
-    std::vector<FcNode> secFCNodes;
+    std::vector<BasicFcNode<Index>> secFCNodes;
+    // x-coordinates of secFCNodes of a leaf bucket with more than one point, scanned instead of descending further
+    std::vector<uint32_t> bucketXs;
+    // all points sharing the x-coordinate of an internal node when duplicates are collapsed and there are more than
+    // one, ascendingly by y and break tie by id, point is the first of them
+    std::vector<Point> duplicates;
+    // guards the on-demand construction of secFCNodes in lazy mode
+    std::once_flag secOnce;
 
-    FcRangeTreeNode* parent{ nullptr };
+    BasicFcRangeTreeNode* parent{ nullptr };
 };
 
+// A canonical run of a fractional cascading range tree: secFCNodes[begin, end) of node all lie in the query range
+template <typename Index>
+struct BasicFcRun {
+    BasicFcRangeTreeNode<Index>* node;
+    std::size_t begin;
+    std::size_t end;
+};
+
+// 32-bit indices address up to 2^32 - 1 points, which is also the limit of Point::id
+using FcNode = BasicFcNode<uint32_t>;
+using FcRangeTreeNode = BasicFcRangeTreeNode<uint32_t>;
+using FcRun = BasicFcRun<uint32_t>;
+
 class IRangeTree {
 public:
+    virtual ~IRangeTree() = default;
+
     /**
      * Construct a range tree based on the given points
      * @param points Points
@@ -133,11 +247,12 @@ public:
     virtual void construct_tree(std::vector<Point>& points, bool isNaive) = 0;
 
     /**
-     * Report all the points that is in the query range
+     * Report all the points that is in the query range, or stop the traversal once limit points are reported
      * @param query Query that specify the range in each dimension
      * @param foundPts All points that are in the query range.
+     * @param limit Maximum number of points to report
      */
-    virtual void report_points(Query query, std::vector<Point>& foundPts) = 0;
+    virtual void report_points(Query query, std::vector<Point>& foundPts, std::size_t limit = NO_LIMIT) = 0;
 };
 
 } // namespace ::Xiuge::RangeTree
@@ -0,0 +1,239 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+#include "approx_counter.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// the coarsest level has at most this many cells per side, small enough to stay in L1
+const std::size_t COARSEST_CELLS = 16;
+
+// number of cells per side of a level whose cells are 2^shift ranks wide
+std::size_t cells_of(std::size_t numPoints, uint32_t shift) {
+    return (numPoints + (std::size_t{1} << shift) - 1) >> shift;
+}
+
+std::size_t level_bytes(std::size_t cells) {
+    return (cells + 1) * (cells + 1) * sizeof(uint32_t);
+}
+
+}
+
+ApproxCounter::ApproxCounter(FcRangeTree& tree, double epsilon, std::size_t memoryBudget)
+        : mTree(tree), mEpsilon(epsilon), mMemoryBudget(memoryBudget) {
+    if (unlikely(!(epsilon > 0)))
+        throw std::runtime_error("[ApproxCounter] epsilon must be positive, got " + std::to_string(epsilon));
+}
+
+void ApproxCounter::RankTable::build(std::vector<uint32_t> newValues) {
+    values = std::move(newValues);
+    std::sort(values.begin(), values.end());
+    bucketStarts.clear();
+
+    if (values.empty())
+        return;
+
+    // about one bucket per value
+    min = values.front();
+    uint64_t range = uint64_t{values.back()} - min;
+    shift = 0;
+    while ((range >> shift) + 1 > values.size())
+        ++shift;
+
+    std::size_t numBuckets = static_cast<std::size_t>(range >> shift) + 1, i = 0;
+    bucketStarts.reserve(numBuckets + 1);
+
+    for (std::size_t b = 0; b <= numBuckets; ++b) {
+        while (i < values.size() && ((values[i] - min) >> shift) < b)
+            ++i;
+
+        bucketStarts.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+uint32_t ApproxCounter::RankTable::rank_below(uint32_t value) const {
+    if (values.empty() || value <= min)
+        return 0;
+
+    std::size_t b = (value - min) >> shift;
+    if (b + 1 >= bucketStarts.size())
+        return static_cast<uint32_t>(values.size());
+
+    auto begin = values.begin() + bucketStarts[b], end = values.begin() + bucketStarts[b + 1];
+    return static_cast<uint32_t>(std::lower_bound(begin, end, value) - values.begin());
+}
+
+uint32_t ApproxCounter::RankTable::rank_upto(uint32_t value) const {
+    if (value == std::numeric_limits<uint32_t>::max())
+        return static_cast<uint32_t>(values.size());
+
+    return rank_below(value + 1);
+}
+
+void ApproxCounter::build(const std::vector<Point>& points) {
+    TraceScope trace("ApproxCounter::build");
+
+    mNumPoints = points.size();
+    mLevels.clear();
+
+    std::vector<uint32_t> xs, ys;
+    xs.reserve(points.size());
+    ys.reserve(points.size());
+    for (auto& point : points) {
+        xs.emplace_back(point.x);
+        ys.emplace_back(point.y);
+    }
+
+    mXRanks.build(xs);
+    mYRanks.build(ys);
+
+    if (points.empty())
+        return;
+
+    // the finest level is the densest one whose grid fits in the budget together with all the coarser ones
+    uint32_t topShift = 0;
+    while (cells_of(mNumPoints, topShift) > COARSEST_CELLS)
+        ++topShift;
+
+    uint32_t finestShift = topShift + 1;
+    for (uint32_t shift = 0; shift <= topShift; ++shift) {
+        std::size_t bytes = 0;
+        for (uint32_t s = shift; s <= topShift; ++s)
+            bytes += level_bytes(cells_of(mNumPoints, s));
+
+        if (bytes <= mMemoryBudget) {
+            finestShift = shift;
+            break;
+        }
+    }
+
+    if (finestShift > topShift) {
+        spdlog::warn("[ApproxCounter] Memory budget of {} bytes cannot hold any level, every count will be exact",
+                     mMemoryBudget);
+        return;
+    }
+
+    // rank of every point in both dimensions, ties in the same coordinate get consecutive ranks in any order
+    std::vector<uint32_t> order(points.size()), xRanks(points.size()), yRanks(points.size());
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&points](uint32_t a, uint32_t b) -> bool { return points[a].x < points[b].x; });
+    for (std::size_t r = 0; r < order.size(); ++r)
+        xRanks[order[r]] = static_cast<uint32_t>(r);
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&points](uint32_t a, uint32_t b) -> bool { return points[a].y < points[b].y; });
+    for (std::size_t r = 0; r < order.size(); ++r)
+        yRanks[order[r]] = static_cast<uint32_t>(r);
+
+    // count the points of every cell of the finest level, shifted by one row and column, then sum up the prefixes
+    Level finest{finestShift, cells_of(mNumPoints, finestShift) + 1, {}};
+    finest.prefix.assign(finest.stride * finest.stride, 0);
+
+    for (std::size_t i = 0; i < points.size(); ++i)
+        ++finest.prefix[((xRanks[i] >> finestShift) + 1) * finest.stride + (yRanks[i] >> finestShift) + 1];
+
+    for (std::size_t i = 1; i < finest.stride; ++i) {
+        for (std::size_t j = 1; j < finest.stride; ++j) {
+            finest.prefix[i * finest.stride + j] += finest.prefix[(i - 1) * finest.stride + j]
+                                                    + finest.prefix[i * finest.stride + j - 1]
+                                                    - finest.prefix[(i - 1) * finest.stride + j - 1];
+        }
+    }
+
+    mLevels.push_back(std::move(finest));
+
+    // a grid line of a coarser level is every other grid line of the finer one, clamped to the last
+    for (uint32_t shift = finestShift + 1; shift <= topShift; ++shift) {
+        const Level& finer = mLevels.back();
+        Level coarser{shift, cells_of(mNumPoints, shift) + 1, {}};
+        coarser.prefix.resize(coarser.stride * coarser.stride);
+
+        for (std::size_t i = 0; i < coarser.stride; ++i) {
+            std::size_t fi = std::min(2 * i, finer.stride - 1);
+
+            for (std::size_t j = 0; j < coarser.stride; ++j) {
+                std::size_t fj = std::min(2 * j, finer.stride - 1);
+                coarser.prefix[i * coarser.stride + j] = finer.prefix[fi * finer.stride + fj];
+            }
+        }
+
+        mLevels.push_back(std::move(coarser));
+    }
+
+    std::reverse(mLevels.begin(), mLevels.end());
+
+    spdlog::debug("[ApproxCounter] Built {} levels over {} points, finest cell of {} ranks, {} bytes", mLevels.size(),
+                  mNumPoints, std::size_t{1} << finestShift, grid_bytes());
+}
+
+std::size_t ApproxCounter::count(Query query) {
+    if (query.x_lower > query.x_upper || query.y_lower > query.y_upper)
+        return 0;
+
+    // the query in rank space, [xBegin, xEnd) x [yBegin, yEnd)
+    std::size_t xBegin = mXRanks.rank_below(query.x_lower), xEnd = mXRanks.rank_upto(query.x_upper);
+    std::size_t yBegin = mYRanks.rank_below(query.y_lower), yEnd = mYRanks.rank_upto(query.y_upper);
+
+    if (xBegin >= xEnd || yBegin >= yEnd)
+        return 0;
+
+    // a column or a row of ranks holds exactly one point
+    std::size_t stripCount = std::min(xEnd - xBegin, yEnd - yBegin);
+
+    for (const Level& level : mLevels) {
+        const uint32_t* prefix = level.prefix.data();
+        const std::size_t stride = level.stride, mask = (std::size_t{1} << level.shift) - 1;
+
+        auto rect = [prefix, stride](std::size_t x0, std::size_t x1, std::size_t y0, std::size_t y1) -> std::size_t {
+            return prefix[x1 * stride + y1] - prefix[x0 * stride + y1] - prefix[x1 * stride + y0]
+                   + prefix[x0 * stride + y0];
+        };
+
+        // cells touched by the query bound the count from above, cells fully inside it from below
+        std::size_t upper = std::min(rect(xBegin >> level.shift, (xEnd + mask) >> level.shift, yBegin >> level.shift,
+                                          (yEnd + mask) >> level.shift), stripCount);
+
+        std::size_t innerX0 = (xBegin + mask) >> level.shift, innerX1 = xEnd >> level.shift;
+        std::size_t innerY0 = (yBegin + mask) >> level.shift, innerY1 = yEnd >> level.shift;
+        std::size_t lower = innerX0 < innerX1 && innerY0 < innerY1 ? rect(innerX0, innerX1, innerY0, innerY1) : 0;
+
+        if (lower == upper)
+            return lower;
+
+        // the estimate with the smallest worst relative error over [lower, upper]
+        auto lowerCount = static_cast<double>(lower), upperCount = static_cast<double>(upper);
+        double estimate = std::round(2 * lowerCount * upperCount / (lowerCount + upperCount));
+
+        if (lower > 0 && estimate - lowerCount <= mEpsilon * lowerCount
+            && upperCount - estimate <= mEpsilon * upperCount)
+            return static_cast<std::size_t>(estimate);
+    }
+
+    ++mFallbacks;
+    return mTree.count_points(query);
+}
+
+std::size_t ApproxCounter::grid_bytes() const {
+    std::size_t bytes = 0;
+    for (auto& level : mLevels)
+        bytes += level.prefix.size() * sizeof(uint32_t);
+
+    return bytes;
+}
+
+} // namespace ::Xiuge::RangeTree
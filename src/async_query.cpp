@@ -0,0 +1,59 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+
+#include "async_query.h"
+
+namespace Xiuge::RangeTree {
+
+Task<std::vector<Point>> report_points_async(IRangeTree& tree, Query query, ThreadPool& pool) {
+    co_await schedule(pool);
+
+    std::vector<Point> foundPts;
+    tree.report_points(query, foundPts);
+    co_return foundPts;
+}
+
+AsyncGenerator<std::vector<Point>> stream_points(FcRangeTree& tree, Query query, std::size_t blockSize,
+                                                 ThreadPool& pool) {
+    co_await schedule(pool);
+
+    blockSize = std::max<std::size_t>(1, blockSize);
+
+    std::vector<Point> pathPts;
+    std::vector<FcRun> runs;
+    tree.find_canonical(query, pathPts, runs);
+
+    // points on the search paths go first, followed by the canonical runs in the order they are found
+    std::vector<Point> block;
+    block.reserve(blockSize);
+
+    for (auto& point : pathPts) {
+        block.emplace_back(point);
+
+        if (block.size() == blockSize) {
+            co_yield std::move(block);
+            block.clear();
+            block.reserve(blockSize);
+        }
+    }
+
+    for (auto& run : runs) {
+        for (auto i = run.begin; i < run.end; ++i) {
+            block.emplace_back(run.node->secFCNodes[i].point);
+
+            if (block.size() == blockSize) {
+                co_yield std::move(block);
+                block.clear();
+                block.reserve(blockSize);
+            }
+        }
+    }
+
+    if (!block.empty())
+        co_yield std::move(block);
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,194 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+#include "batch_counter.h"
+#include "radix_sort.h"
+#include "thread_pool.h"
+#include "tracer.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// do not bother splitting the sweep for small inputs
+const std::size_t MIN_POINTS_PER_SLAB = 1 << 16;
+
+// Boundary of a query in the sweep: the number of points with x <= x and y-rank in [rankBegin, rankEnd)
+struct Event {
+    uint32_t x;
+    uint32_t query;
+    bool isUpper;
+};
+
+// Fenwick tree over y-ranks, the counters are 32 bits so that more of the tree stays in cache
+class Fenwick {
+public:
+    /**
+     * Build the tree in O(m) time
+     * @param counts Initial number of points of each rank
+     */
+    explicit Fenwick(const std::vector<uint32_t>& counts) : mTree(counts.size() + 1, 0) {
+        std::copy(counts.begin(), counts.end(), mTree.begin() + 1);
+
+        for (std::size_t i = 1; i < mTree.size(); ++i) {
+            std::size_t parent = i + (i & (~i + 1));
+            if (parent < mTree.size())
+                mTree[parent] += mTree[i];
+        }
+    }
+
+    void add(std::size_t rank) {
+        for (std::size_t i = rank + 1; i < mTree.size(); i += i & (~i + 1))
+            ++mTree[i];
+    }
+
+    // number of points with rank < end
+    uint32_t prefix(std::size_t end) const {
+        uint32_t sum = 0;
+
+        for (std::size_t i = end; i > 0; i -= i & (~i + 1))
+            sum += mTree[i];
+
+        return sum;
+    }
+
+private:
+    std::vector<uint32_t> mTree;
+};
+
+}
+
+BatchCounter::BatchCounter(std::size_t numThreads) : mNumThreads(std::max<std::size_t>(numThreads, 1)) {}
+
+std::vector<std::size_t> BatchCounter::count(const std::vector<Point>& points, const std::vector<Query>& queries) {
+    TraceScope trace("BatchCounter::count");
+
+    std::vector<std::size_t> counts(queries.size(), 0);
+    if (points.empty() || queries.empty())
+        return counts;
+
+    // the sweep only needs the points ordered by x
+    std::vector<Point> sortedPts = points, buffer;
+    radix_sort(sortedPts, buffer, {&Point::x}, mNumThreads);
+
+    // rank-compress y
+    std::vector<uint32_t> ys;
+    ys.reserve(sortedPts.size());
+    for (auto& point : sortedPts)
+        ys.emplace_back(point.y);
+
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    auto rank_of = [&ys](uint32_t y) -> std::size_t {
+        return static_cast<std::size_t>(std::lower_bound(ys.begin(), ys.end(), y) - ys.begin());
+    };
+
+    // y-rank range of each query, and its two x-events, the lower one is dropped if nothing can be left of it
+    std::vector<std::size_t> rankBegins(queries.size()), rankEnds(queries.size());
+    std::vector<Event> events;
+    events.reserve(2 * queries.size());
+
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+        const Query& query = queries[q];
+        rankBegins[q] = rank_of(query.y_lower);
+        rankEnds[q] = static_cast<std::size_t>(std::upper_bound(ys.begin(), ys.end(), query.y_upper) - ys.begin());
+
+        if (query.x_lower > query.x_upper || rankBegins[q] >= rankEnds[q])
+            continue;
+
+        events.push_back({query.x_upper, static_cast<uint32_t>(q), true});
+        if (query.x_lower > 0)
+            events.push_back({query.x_lower - 1, static_cast<uint32_t>(q), false});
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) -> bool { return a.x < b.x; });
+
+    // split the points into slabs of about the same size, never between two points of the same x
+    std::size_t numSlabs = std::clamp<std::size_t>(sortedPts.size() / MIN_POINTS_PER_SLAB, 1, mNumThreads);
+    std::vector<std::size_t> slabBegins{0};
+
+    for (std::size_t s = 1; s < numSlabs; ++s) {
+        std::size_t begin = std::max(s * sortedPts.size() / numSlabs, slabBegins.back());
+        while (begin < sortedPts.size() && begin > 0 && sortedPts[begin].x == sortedPts[begin - 1].x)
+            ++begin;
+
+        if (begin > slabBegins.back() && begin < sortedPts.size())
+            slabBegins.push_back(begin);
+    }
+
+    numSlabs = slabBegins.size();
+    slabBegins.push_back(sortedPts.size());
+
+    // an event belongs to the slab with the largest starting x not above it, events left of every point go to slab 0
+    std::vector<std::size_t> eventBegins{0};
+    for (std::size_t s = 1; s < numSlabs; ++s) {
+        uint32_t startX = sortedPts[slabBegins[s]].x;
+        eventBegins.push_back(static_cast<std::size_t>(
+                std::lower_bound(events.begin(), events.end(), startX,
+                                 [](const Event& event, uint32_t x) -> bool { return event.x < x; })
+                - events.begin()));
+    }
+    eventBegins.push_back(events.size());
+
+    // histograms[s][r]: points of rank r in slab s, turned into the points of rank r in all the slabs left of s
+    std::vector<std::vector<uint32_t>> histograms(numSlabs, std::vector<uint32_t>(ys.size(), 0));
+    std::vector<uint32_t> pointRanks(sortedPts.size());
+
+    ThreadPool::shared().parallel_for(numSlabs, [&](std::size_t s) {
+        for (std::size_t i = slabBegins[s]; i < slabBegins[s + 1]; ++i) {
+            pointRanks[i] = static_cast<uint32_t>(rank_of(sortedPts[i].y));
+            ++histograms[s][pointRanks[i]];
+        }
+    });
+
+    ThreadPool::shared().parallel_for(numSlabs, [&](std::size_t t) {
+        std::size_t begin = t * ys.size() / numSlabs, end = (t + 1) * ys.size() / numSlabs;
+
+        for (std::size_t r = begin; r < end; ++r) {
+            uint32_t sum = 0;
+
+            for (std::size_t s = 0; s < numSlabs; ++s) {
+                uint32_t slabCount = histograms[s][r];
+                histograms[s][r] = sum;
+                sum += slabCount;
+            }
+        }
+    });
+
+    // sweep every slab, each event is answered exactly once, by the slab it belongs to
+    std::vector<uint32_t> upperCounts(queries.size(), 0), lowerCounts(queries.size(), 0);
+
+    ThreadPool::shared().parallel_for(numSlabs, [&](std::size_t s) {
+        TraceScope slabTrace("BatchCounter sweep slab");
+
+        Fenwick fenwick(histograms[s]);
+        std::vector<uint32_t>().swap(histograms[s]);
+
+        std::size_t i = slabBegins[s];
+
+        for (std::size_t e = eventBegins[s]; e < eventBegins[s + 1]; ++e) {
+            const Event& event = events[e];
+
+            while (i < slabBegins[s + 1] && sortedPts[i].x <= event.x)
+                fenwick.add(pointRanks[i++]);
+
+            uint32_t inRange = fenwick.prefix(rankEnds[event.query]) - fenwick.prefix(rankBegins[event.query]);
+            (event.isUpper ? upperCounts : lowerCounts)[event.query] = inRange;
+        }
+    });
+
+    for (std::size_t q = 0; q < queries.size(); ++q)
+        counts[q] = upperCounts[q] - lowerCounts[q];
+
+    spdlog::debug("[BatchCounter] Counted {} queries over {} points in {} slabs", queries.size(), points.size(),
+                  numSlabs);
+
+    return counts;
+}
+
+} // namespace ::Xiuge::RangeTree
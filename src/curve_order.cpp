@@ -0,0 +1,121 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+#include "curve_order.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// move the 32 bits of value to the even bit positions of the result
+uint64_t spread_bits(uint32_t value) {
+    uint64_t bits = value;
+    bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFull;
+    bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFull;
+    bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+    bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+
+    return bits;
+}
+
+}
+
+std::string to_string(CurveKind kind) {
+    switch (kind) {
+        case CurveKind::Morton:
+            return "Morton";
+        case CurveKind::Hilbert:
+            return "Hilbert";
+    }
+
+    return "Unknown";
+}
+
+uint64_t morton_index(uint32_t x, uint32_t y) {
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+uint64_t hilbert_index(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+
+    // from the largest quadrants down, add the cells of the quadrants before this one, then rotate the coordinates
+    // into the orientation of the curve inside this quadrant
+    for (uint32_t s = 1u << 31; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+        index += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+        if (ry == 0) {
+            if (rx == 1) {
+                x = ~x;
+                y = ~y;
+            }
+
+            std::swap(x, y);
+        }
+    }
+
+    return index;
+}
+
+void CurveRenumbering::renumber(std::vector<Point>& points, CurveKind kind) {
+    TraceScope trace("CurveRenumbering::renumber");
+
+    if (unlikely(points.size() >= UINT32_MAX))
+        throw std::runtime_error("[CurveRenumbering] too many points to renumber, size=" +
+                                 std::to_string(points.size()));
+
+    // curve position of every point, break tie by the original id so that the order is deterministic
+    std::vector<std::pair<uint64_t, uint32_t>> keys(points.size());
+
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        const Point& point = points[i];
+        keys[i] = {kind == CurveKind::Hilbert ? hilbert_index(point.x, point.y) : morton_index(point.x, point.y),
+                   static_cast<uint32_t>(i)};
+    }
+
+    std::sort(keys.begin(), keys.end(), [&points](const auto& a, const auto& b) -> bool {
+        return a.first == b.first ? points[a.second].id < points[b.second].id : a.first < b.first;
+    });
+
+    std::vector<Point> ordered;
+    ordered.reserve(points.size());
+    mOriginalIds.assign(1, 0);
+    mXs.assign(1, 0);
+    mYs.assign(1, 0);
+
+    for (auto& key : keys) {
+        Point point = points[key.second];
+        mOriginalIds.emplace_back(point.id);
+        mXs.emplace_back(point.x);
+        mYs.emplace_back(point.y);
+
+        point.id = static_cast<uint32_t>(ordered.size() + 1);
+        ordered.emplace_back(point);
+    }
+
+    points.swap(ordered);
+
+    spdlog::debug("[CurveRenumbering] Renumbered {} points along the {} curve", points.size(), to_string(kind));
+}
+
+void CurveRenumbering::restore_ids(std::vector<Point>& points) const {
+    for (auto& point : points)
+        point.id = mOriginalIds[point.id];
+}
+
+Point CurveRenumbering::point_of(uint32_t id) const {
+    Point point(mXs[id], mYs[id]);
+    point.id = id;
+
+    return point;
+}
+
+} // namespace ::Xiuge::RangeTree
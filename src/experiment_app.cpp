@@ -2,6 +2,10 @@
 // Created by Xiuge Chen on 5/25/20.
 //
 
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <shared_mutex>
 #include <spdlog/spdlog.h>
 
 #include "experiment_app.h"
@@ -12,6 +16,50 @@ namespace {
 
 const uint32_t N = 1000000;
 const uint32_t NUM_REPEAT = 100;
+const std::size_t STREAM_BLOCK_SIZE = 1024;
+
+long long int now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now().time_since_epoch()
+    ).count();
+}
+
+long long int now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// log the median, tail and maximum of the latencies, which get sorted
+void log_latencies(const std::string& name, uint32_t len, std::vector<long long int>& latencies) {
+    if (latencies.empty())
+        return;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) -> long long int {
+        return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+
+    spdlog::info("[ExperimentApp] Finish query latency testing on {} with data length={}, queries={}, p50={}ns, "
+                 "p99={}ns, p99.9={}ns, max={}ns", name, len, latencies.size(), percentile(0.5), percentile(0.99),
+                 percentile(0.999), latencies.back());
+}
+
+// drain a stream of point blocks, return the time to the first block and the time to the last block since startTime
+Task<std::pair<long long int, long long int>> consume_stream(AsyncGenerator<std::vector<Point>> stream,
+                                                           long long int startTime, std::size_t& k) {
+    long long int firstTime = -1;
+
+    while (auto block = co_await stream.next()) {
+        if (firstTime < 0)
+            firstTime = now_us() - startTime;
+
+        k = k + block->size();
+    }
+
+    long long int lastTime = now_us() - startTime;
+    co_return std::make_pair(firstTime < 0 ? lastTime : firstTime, lastTime);
+}
 
 }
 
@@ -58,6 +106,17 @@ void ExperimentApp::construct_time_data_length(const std::vector<uint32_t>& data
 
         spdlog::info("[ExperimentApp] Finish construction time testing on Original Range Tree with smart construction algorithm and data"
                      "length={}, running time={}", len, endTime - startTime);
+
+        // Test on scan engine baseline
+        std::vector<Point> scan_copy{vec};
+        ScanEngine scanEngine;
+
+        startTime = now_us();
+        scanEngine.construct_tree(scan_copy, false);
+        endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish construction time testing on Scan Engine with data"
+                     "length={}, running time={}", len, endTime - startTime);
     }
 }
 
@@ -128,6 +187,14 @@ void ExperimentApp::query_time_data_length(const std::vector<uint32_t>& dataLens
 
         spdlog::info("[ExperimentApp] Finish query time testing on Fractional Cascading Range Tree with data"
                      "length={}, range={}, k={}, running time={}", len, range, sum_k / NUM_REPEAT, sum_time / NUM_REPEAT);
+
+        // Test on scan engine baseline, single-threaded and parallel
+        ScanEngine scanEngine, parallelScanEngine(std::thread::hardware_concurrency());
+        scanEngine.construct_tree(dataVec, false);
+        parallelScanEngine.construct_tree(dataVec, false);
+
+        scan_query_time(scanEngine, "Scan Engine", queryVec, len, range);
+        scan_query_time(parallelScanEngine, "Parallel Scan Engine", queryVec, len, range);
     }
 }
 
@@ -143,6 +210,10 @@ void ExperimentApp::query_time_query_range(const std::vector<double>& queryRange
     FcRangeTree fcRangeTree;
     fcRangeTree.construct_tree(dataVec, false);
 
+    ScanEngine scanEngine, parallelScanEngine(std::thread::hardware_concurrency());
+    scanEngine.construct_tree(dataVec, false);
+    parallelScanEngine.construct_tree(dataVec, false);
+
     for (auto rangePer: queryRangePers) {
         auto range = static_cast<uint32_t>(rangePer * N);
         spdlog::info("Start with query range={}", range);
@@ -197,7 +268,1376 @@ void ExperimentApp::query_time_query_range(const std::vector<double>& queryRange
 
         spdlog::info("[ExperimentApp] Finish query time testing on Fractional Cascading Range Tree with data"
                      "length={}, range={}, k={}, running time={}", N, range,  sum_k / NUM_REPEAT, sum_time / NUM_REPEAT);
+
+        // Test on scan engine baseline, single-threaded and parallel
+        scan_query_time(scanEngine, "Scan Engine", queryVec, N, range);
+        scan_query_time(parallelScanEngine, "Parallel Scan Engine", queryVec, N, range);
+    }
+}
+
+void ExperimentApp::query_time_planner(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start query time test of the adaptive query planner with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    QueryPlanner planner;
+    planner.construct_tree(dataVec, false);
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        planner.clear_choices();
+
+        long long int sum_time = 0;
+        unsigned long long int sum_k = 0;
+
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            long long int startTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::high_resolution_clock::now().time_since_epoch()
+            ).count();
+
+            std::vector<Point> result;
+            planner.report_points(queryVec[i], result);
+
+            long long int endTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::high_resolution_clock::now().time_since_epoch()
+            ).count();
+
+            sum_time = sum_time + (endTime - startTime);
+            sum_k = sum_k + result.size();
+        }
+
+        auto usage = planner.engine_usage();
+
+        spdlog::info("[ExperimentApp] Finish query time testing on Query Planner with data"
+                     "length={}, range={}, k={}, running time={}, routed FractionalCascading={}, Original={}, Scan={}, "
+                     "Grid={}", N, range, sum_k / NUM_REPEAT, sum_time / NUM_REPEAT, usage[0], usage[1], usage[2],
+                     usage[3]);
+    }
+}
+
+void ExperimentApp::query_time_async(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start query time test of the asynchronous streaming query with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree fcRangeTree;
+    fcRangeTree.construct_tree(dataVec, false);
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        // Test on awaitable query, the whole result arrives at once
+        long long int sum_time = 0;
+        unsigned long long int sum_k = 0;
+
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            long long int startTime = now_us();
+            auto result = sync_wait(report_points_async(fcRangeTree, queryVec[i]));
+            long long int endTime = now_us();
+
+            sum_time = sum_time + (endTime - startTime);
+            sum_k = sum_k + result.size();
+        }
+
+        spdlog::info("[ExperimentApp] Finish query time testing on awaitable Fractional Cascading Range Tree with data"
+                     "length={}, range={}, k={}, running time={}", N, range, sum_k / NUM_REPEAT, sum_time / NUM_REPEAT);
+
+        // Test on streaming query, record the time to the first block
+        long long int sum_first_time = 0;
+        sum_time = 0;
+        sum_k = 0;
+
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            std::size_t k = 0;
+            long long int startTime = now_us();
+            auto [firstTime, lastTime] = sync_wait(consume_stream(
+                    stream_points(fcRangeTree, queryVec[i], STREAM_BLOCK_SIZE), startTime, k));
+
+            sum_first_time = sum_first_time + firstTime;
+            sum_time = sum_time + lastTime;
+            sum_k = sum_k + k;
+        }
+
+        spdlog::info("[ExperimentApp] Finish query time testing on streaming Fractional Cascading Range Tree with data"
+                     "length={}, range={}, k={}, time to first block={}, running time={}", N, range, sum_k / NUM_REPEAT,
+                     sum_first_time / NUM_REPEAT, sum_time / NUM_REPEAT);
+    }
+}
+
+void ExperimentApp::query_stats_query_range(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start query traversal counter test with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    OrgRangeTree orgRangeTree;
+    orgRangeTree.construct_tree(dataVec, false);
+
+    FcRangeTree fcRangeTree;
+    fcRangeTree.construct_tree(dataVec, false);
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        query_stats(orgRangeTree, "Original Range Tree", queryVec, range);
+        query_stats(fcRangeTree, "Fractional Cascading Range Tree", queryVec, range);
+    }
+}
+
+template <typename Tree>
+void ExperimentApp::query_stats(Tree& tree, const std::string& treeName, std::vector<Query>& queryVec, uint32_t range) {
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+    QueryStats sum_stats;
+
+    for (auto& query : queryVec) {
+        long long int startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result, sum_stats);
+
+        long long int endTime = now_us();
+
+        sum_time = sum_time + (endTime - startTime);
+        sum_k = sum_k + result.size();
+    }
+
+    auto num = queryVec.size();
+
+    spdlog::info("[ExperimentApp] Finish query traversal counter testing on {} with data"
+                 "length={}, range={}, k={}, running time={}, primary nodes={}, cascade hops={}, canonical subtrees={}, "
+                 "secondary searches={}, range rejections={}", treeName, N, range, sum_k / num, sum_time / num,
+                 sum_stats.primaryNodes / num, sum_stats.cascadeHops / num, sum_stats.canonicalSubtrees / num,
+                 sum_stats.secondarySearches / num, sum_stats.rangeRejections / num);
+}
+
+void ExperimentApp::load_time_data_length(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start load time test with various data length");
+
+    mDataGenerator.set_range(1, N);
+
+    auto csvPath = (std::filesystem::temp_directory_path() / "range_tree_points.csv").string();
+    auto binaryPath = (std::filesystem::temp_directory_path() / "range_tree_points.bin").string();
+    PointLoader loader;
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        auto vec = mDataGenerator.generate_point_set(len);
+        PointLoader::save_csv(csvPath, vec);
+        PointLoader::save_binary(binaryPath, vec);
+
+        long long int startTime = now_us();
+        auto csvPts = loader.load_csv(csvPath);
+        long long int endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish load time testing on CSV file with data"
+                     "length={}, running time={}, throughput={:.1f} MB/s", csvPts.size(), endTime - startTime,
+                     loader.last_throughput());
+
+        startTime = now_us();
+        auto binaryPts = loader.load_binary(binaryPath);
+        endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish load time testing on binary file with data"
+                     "length={}, running time={}, throughput={:.1f} MB/s", binaryPts.size(), endTime - startTime,
+                     loader.last_throughput());
+
+        // loaded points go straight into construction
+        FcRangeTree fcRangeTree;
+        fcRangeTree.construct_tree(binaryPts, false);
+    }
+
+    std::filesystem::remove(csvPath);
+    std::filesystem::remove(binaryPath);
+}
+
+void ExperimentApp::construct_time_sort_backend(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start construction time test with various sort backend and data length");
+
+    mDataGenerator.set_range(1, N);
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        auto vec = mDataGenerator.generate_point_set(len);
+
+        for (auto backend : {SortBackend::Std, SortBackend::Radix}) {
+            std::string backendName = backend == SortBackend::Std ? "std::sort" : "radix sort";
+
+            std::vector<Point> org_copy{vec};
+            OrgRangeTree orgRangeTree;
+            orgRangeTree.set_sort_backend(backend);
+
+            long long int startTime = now_us();
+            orgRangeTree.construct_tree(org_copy, false);
+            long long int endTime = now_us();
+
+            spdlog::info("[ExperimentApp] Finish construction time testing on Original Range Tree with {} and data"
+                         "length={}, running time={}", backendName, len, endTime - startTime);
+
+            std::vector<Point> fc_copy{vec};
+            FcRangeTree fcRangeTree;
+            fcRangeTree.set_sort_backend(backend);
+
+            startTime = now_us();
+            fcRangeTree.construct_tree(fc_copy, false);
+            endTime = now_us();
+
+            spdlog::info("[ExperimentApp] Finish construction time testing on Fractional Cascading Range Tree with {} "
+                         "and data length={}, running time={}", backendName, len, endTime - startTime);
+
+            // sorting alone, without the rest of the construction
+            std::vector<Point> sort_copy{vec}, buffer;
+
+            startTime = now_us();
+            sort_by_x(sort_copy, backend, buffer);
+            sort_by_y(sort_copy, backend, buffer);
+            endTime = now_us();
+
+            spdlog::info("[ExperimentApp] Finish pre-sort time testing with {} and data length={}, running time={}",
+                         backendName, len, endTime - startTime);
+        }
+    }
+}
+
+void ExperimentApp::construct_time_lazy(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start construction time test of lazy construction with various data length");
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        mDataGenerator.set_range(1, N);
+        auto dataVec = mDataGenerator.generate_point_set(len);
+
+        // skewed workload, all queries fall into the lowest 10% of both dimensions
+        mDataGenerator.set_range(1, N / 10);
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.01 * N)));
+        }
+
+        for (bool lazy : {false, true}) {
+            OrgRangeTree orgRangeTree;
+            lazy_time(orgRangeTree, "Original Range Tree", lazy, dataVec, queryVec);
+
+            FcRangeTree fcRangeTree;
+            lazy_time(fcRangeTree, "Fractional Cascading Range Tree", lazy, dataVec, queryVec);
+        }
+    }
+
+    mDataGenerator.set_range(1, N);
+}
+
+template <typename Tree>
+void ExperimentApp::lazy_time(Tree& tree, const std::string& treeName, bool lazy, std::vector<Point> dataVec,
+                              std::vector<Query>& queryVec) {
+    tree.set_lazy(lazy);
+
+    long long int startTime = now_us();
+    tree.construct_tree(dataVec, false);
+    long long int constructTime = now_us() - startTime;
+
+    std::vector<Point> result;
+    tree.report_points(queryVec[0], result);
+    long long int firstQueryTime = now_us() - startTime;
+
+    for (auto& query : queryVec) {
+        result.clear();
+        tree.report_points(query, result);
+    }
+
+    long long int workloadTime = now_us() - startTime;
+
+    spdlog::info("[ExperimentApp] Finish lazy construction testing on {} with lazy={} and data length={}, construction "
+                 "time={}, time to first query={}, time to finish skewed workload={}", treeName, lazy, dataVec.size(),
+                 constructTime, firstQueryTime, workloadTime);
+}
+
+void ExperimentApp::query_time_batch(const std::vector<uint32_t>& dataLens, const std::vector<std::size_t>& groupSizes) {
+    spdlog::info("Start query time test of interleaved batch queries with various data length");
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        mDataGenerator.set_range(1, N);
+        auto dataVec = mDataGenerator.generate_point_set(len);
+
+        FcRangeTree fcRangeTree;
+        fcRangeTree.construct_tree(dataVec, false);
+
+        // small ranges, so that the time is dominated by the traversal rather than by the output
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT * NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.001 * N)));
+        }
+
+        // Test on one query at a time
+        unsigned long long int sum_k = 0;
+        long long int startTime = now_us();
+
+        for (auto& query : queryVec) {
+            std::vector<Point> result;
+            fcRangeTree.report_points(query, result);
+            sum_k = sum_k + result.size();
+        }
+
+        long long int sum_time = now_us() - startTime;
+
+        spdlog::info("[ExperimentApp] Finish query time testing on sequential Fractional Cascading Range Tree with data "
+                     "length={}, queries={}, k={}, running time={}", len, queryVec.size(), sum_k / queryVec.size(),
+                     sum_time);
+
+        // Test on interleaved queries
+        for (auto groupSize : groupSizes) {
+            std::vector<std::vector<Point>> results;
+            sum_k = 0;
+            startTime = now_us();
+
+            fcRangeTree.report_points_batch(queryVec, results, groupSize);
+
+            sum_time = now_us() - startTime;
+            for (auto& result : results)
+                sum_k = sum_k + result.size();
+
+            spdlog::info("[ExperimentApp] Finish query time testing on batch Fractional Cascading Range Tree with data "
+                         "length={}, queries={}, group size={}, k={}, running time={}", len, queryVec.size(), groupSize,
+                         sum_k / queryVec.size(), sum_time);
+        }
+    }
+}
+
+void ExperimentApp::query_time_secondary_layout(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start query time test of the secondary layouts of original range tree with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    std::vector<std::pair<std::string, SecondaryLayout>> layouts{{"tree", SecondaryLayout::Tree},
+                                                                 {"array", SecondaryLayout::Array}};
+    std::vector<std::unique_ptr<OrgRangeTree>> trees;
+
+    for (auto& [layoutName, layout] : layouts) {
+        trees.emplace_back(std::make_unique<OrgRangeTree>());
+        trees.back()->set_secondary_layout(layout);
+
+        long long int startTime = now_us();
+        trees.back()->construct_tree(dataVec, false);
+        long long int endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish construction time testing on Original Range Tree with secondary {}, data "
+                     "length={}, running time={}", layoutName, N, endTime - startTime);
+    }
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        for (std::size_t t = 0; t < trees.size(); ++t) {
+            long long int sum_time = 0;
+            unsigned long long int sum_k = 0;
+
+            for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+                long long int startTime = now_us();
+
+                std::vector<Point> result;
+                trees[t]->report_points(queryVec[i], result);
+
+                long long int endTime = now_us();
+
+                sum_time = sum_time + (endTime - startTime);
+                sum_k = sum_k + result.size();
+            }
+
+            spdlog::info("[ExperimentApp] Finish query time testing on Original Range Tree with secondary {}, data "
+                         "length={}, range={}, k={}, running time={}", layouts[t].first, N, range, sum_k / NUM_REPEAT,
+                         sum_time / NUM_REPEAT);
+        }
     }
 }
 
+void ExperimentApp::query_time_aggregate(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start query time test of weighted aggregates with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree fcRangeTree;
+    fcRangeTree.construct_tree(dataVec, false);
+
+    // ids are in [1, N], reuse the x-coordinates of another point set as weights
+    std::vector<uint64_t> weights{0};
+    for (auto& point : mDataGenerator.generate_point_set(N))
+        weights.emplace_back(point.x);
+
+    RangeAggregator<SumOp<uint64_t>> sumAggregator(fcRangeTree);
+    sumAggregator.build(weights);
+
+    RangeAggregator<MaxOp<uint64_t>> maxAggregator(fcRangeTree);
+    maxAggregator.build(weights);
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        // Test on reporting the points and folding their weights
+        long long int sum_time = 0;
+        unsigned long long int sum_k = 0;
+
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            long long int startTime = now_us();
+
+            std::vector<Point> result;
+            fcRangeTree.report_points(queryVec[i], result);
+
+            uint64_t sum = 0;
+            for (auto& point : result)
+                sum += weights[point.id];
+
+            long long int endTime = now_us();
+
+            sum_time = sum_time + (endTime - startTime);
+            sum_k = sum_k + result.size();
+        }
+
+        spdlog::info("[ExperimentApp] Finish query time testing on reported sum with data length={}, range={}, k={}, "
+                     "running time={}", N, range, sum_k / NUM_REPEAT, sum_time / NUM_REPEAT);
+
+        // Test on prefix sums and on block sparse tables
+        long long int sum_sum_time = 0, sum_max_time = 0;
+
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            long long int startTime = now_us();
+            sumAggregator.aggregate(queryVec[i]);
+            long long int midTime = now_us();
+            maxAggregator.aggregate(queryVec[i]);
+            long long int endTime = now_us();
+
+            sum_sum_time = sum_sum_time + (midTime - startTime);
+            sum_max_time = sum_max_time + (endTime - midTime);
+        }
+
+        spdlog::info("[ExperimentApp] Finish query time testing on aggregates with data length={}, range={}, sum "
+                     "running time={}, max running time={}", N, range, sum_sum_time / NUM_REPEAT,
+                     sum_max_time / NUM_REPEAT);
+    }
+}
+
+void ExperimentApp::query_time_batch_count(const std::vector<uint32_t>& queryCounts) {
+    spdlog::info("Start query time test of offline batch counting with various number of queries");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree fcRangeTree;
+    auto treeVec = dataVec;
+    fcRangeTree.construct_tree(treeVec, false);
+
+    for (auto numQueries : queryCounts) {
+        spdlog::info("Start with number of queries={}", numQueries);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < numQueries; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.05 * N)));
+        }
+
+        // Test on counting one query at a time
+        unsigned long long int sum_k = 0;
+        long long int startTime = now_us();
+
+        for (auto& query : queryVec)
+            sum_k = sum_k + fcRangeTree.count_points(query);
+
+        long long int endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish batch count testing on Fractional Cascading Range Tree with data length={}, "
+                     "queries={}, k={}, running time={}", N, numQueries, sum_k / numQueries, endTime - startTime);
+
+        // Test on the sweep, single slab and one slab per hardware thread
+        for (std::size_t numThreads : {std::size_t{1}, std::size_t{std::thread::hardware_concurrency()}}) {
+            BatchCounter batchCounter(numThreads);
+
+            startTime = now_us();
+            auto counts = batchCounter.count(dataVec, queryVec);
+            endTime = now_us();
+
+            sum_k = 0;
+            for (auto count : counts)
+                sum_k = sum_k + count;
+
+            spdlog::info("[ExperimentApp] Finish batch count testing on sweep with data length={}, queries={}, "
+                         "threads={}, k={}, running time={}", N, numQueries, numThreads, sum_k / numQueries,
+                         endTime - startTime);
+        }
+    }
+}
+
+void ExperimentApp::query_latency_rebuild(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start query latency test during rebuilds with various data length");
+
+    mDataGenerator.set_range(1, N);
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        auto dataVec = mDataGenerator.generate_point_set(len);
+        auto newDataVec = mDataGenerator.generate_point_set(len);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.01 * N)));
+        }
+
+        // Test on snapshots, the rebuild runs on a background thread while the queries keep going
+        SnapshotManager snapshotManager;
+        auto pointsVec = dataVec;
+        snapshotManager.construct_tree(pointsVec, false);
+
+        std::vector<long long int> quietLatencies, rebuildLatencies;
+
+        for (unsigned int i = 0; i < NUM_REPEAT * NUM_REPEAT; ++i) {
+            std::vector<Point> result;
+            long long int startTime = now_ns();
+            snapshotManager.report_points(queryVec[i % NUM_REPEAT], result);
+            quietLatencies.emplace_back(now_ns() - startTime);
+        }
+
+        snapshotManager.rebuild_async(newDataVec);
+
+        for (unsigned int i = 0; snapshotManager.version() < 2; ++i) {
+            std::vector<Point> result;
+            long long int startTime = now_ns();
+            snapshotManager.report_points(queryVec[i % NUM_REPEAT], result);
+            rebuildLatencies.emplace_back(now_ns() - startTime);
+        }
+
+        snapshotManager.wait_rebuild();
+
+        log_latencies("snapshots without rebuild", len, quietLatencies);
+        log_latencies("snapshots during rebuild", len, rebuildLatencies);
+
+        // Test on a single tree rebuilt in place under a readers-writer lock
+        FcRangeTree fcRangeTree;
+        pointsVec = dataVec;
+        fcRangeTree.construct_tree(pointsVec, false);
+
+        std::shared_mutex treeMutex;
+        std::atomic<bool> rebuilt{false};
+        std::vector<long long int> lockedLatencies;
+
+        std::thread rebuilder([&] {
+            auto newPointsVec = newDataVec;
+            std::unique_lock<std::shared_mutex> lock(treeMutex);
+            fcRangeTree.construct_tree(newPointsVec, false);
+            rebuilt = true;
+        });
+
+        for (unsigned int i = 0; !rebuilt; ++i) {
+            std::vector<Point> result;
+            long long int startTime = now_ns();
+            {
+                std::shared_lock<std::shared_mutex> lock(treeMutex);
+                fcRangeTree.report_points(queryVec[i % NUM_REPEAT], result);
+            }
+            lockedLatencies.emplace_back(now_ns() - startTime);
+        }
+
+        rebuilder.join();
+
+        log_latencies("locked tree during rebuild", len, lockedLatencies);
+    }
+}
+
+void ExperimentApp::construct_time_index_width(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start construction time test of index widths with various data length");
+
+    mDataGenerator.set_range(1, N);
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        auto dataVec = mDataGenerator.generate_point_set(len);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.01 * N)));
+        }
+
+        index_width_time<uint32_t>("32 bits", dataVec, queryVec);
+        index_width_time<PackedIndex40>("packed 40 bits", dataVec, queryVec);
+        index_width_time<uint64_t>("64 bits", dataVec, queryVec);
+    }
+}
+
+template <typename Index>
+void ExperimentApp::index_width_time(const std::string& indexName, std::vector<Point> dataVec,
+                                     std::vector<Query>& queryVec) {
+    BasicFcRangeTree<Index> tree;
+
+    long long int startTime = now_us();
+    tree.construct_tree(dataVec, false);
+    long long int constructTime = now_us() - startTime;
+
+    std::size_t secBytes = 0;
+    tree.for_each_node([&secBytes](const typename BasicFcRangeTree<Index>::Node* node) {
+        secBytes += node->secFCNodes.size() * sizeof(typename BasicFcRangeTree<Index>::SecNode);
+    });
+
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+
+    for (auto& query : queryVec) {
+        startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        sum_time = sum_time + (now_us() - startTime);
+        sum_k = sum_k + result.size();
+    }
+
+    spdlog::info("[ExperimentApp] Finish index width testing on Fractional Cascading Range Tree with {} index, data "
+                 "length={}, node size={}, secondary arrays={} bytes, construction time={}, k={}, running time={}",
+                 indexName, dataVec.size(), sizeof(typename BasicFcRangeTree<Index>::SecNode), secBytes,
+                 constructTime, sum_k / queryVec.size(), sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::query_time_scan_kernel(const std::vector<uint32_t>& dataLens) {
+    spdlog::info("Start query time test of the scan kernels with various data length");
+
+    mDataGenerator.set_range(1, N);
+
+    for (auto len: dataLens) {
+        spdlog::info("Start with data length={}", len);
+
+        auto range = static_cast<uint32_t>(0.05 * N);
+
+        auto dataVec = mDataGenerator.generate_point_set(len);
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        ScanEngine scanEngine;
+        scanEngine.construct_tree(dataVec, false);
+
+        for (auto kernel : {ScanKernel::Scalar, ScanKernel::Avx2, ScanKernel::Avx512}) {
+            if (kernel > ScanEngine::best_kernel())
+                continue;
+
+            scanEngine.set_kernel(kernel);
+            scan_query_time(scanEngine, "Scan Engine with " + to_string(kernel) + " kernel", queryVec, len, range);
+        }
+    }
+}
+
+void ExperimentApp::scan_query_time(ScanEngine& scanEngine, const std::string& engineName,
+                                    std::vector<Query>& queryVec, uint32_t len, uint32_t range) {
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+
+    for (auto& query : queryVec) {
+        long long int startTime = now_us();
+
+        std::vector<Point> scanResult;
+        scanEngine.report_points(query, scanResult);
+
+        long long int endTime = now_us();
+
+        sum_time = sum_time + (endTime - startTime);
+        sum_k = sum_k + scanResult.size();
+    }
+
+    spdlog::info("[ExperimentApp] Finish query time testing on {} with data length={}, range={}, k={}, running time={}",
+                 engineName, len, range, sum_k / queryVec.size(), sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::query_time_leaf_size(const std::vector<std::size_t>& leafSizes) {
+    spdlog::info("Start construction and query time test of both trees with various leaf bucket size");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    auto range = static_cast<uint32_t>(0.05 * N);
+    std::vector<Query> queryVec;
+    for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+        queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+    }
+
+    for (auto leafSize : leafSizes) {
+        spdlog::info("Start with leaf size={}", leafSize);
+
+        OrgRangeTree orgRangeTree;
+        leaf_size_time(orgRangeTree, "Original Range Tree", leafSize, dataVec, queryVec, range);
+
+        FcRangeTree fcRangeTree;
+        leaf_size_time(fcRangeTree, "Fractional Cascading Range Tree", leafSize, dataVec, queryVec, range);
+    }
+}
+
+template <typename Tree>
+void ExperimentApp::leaf_size_time(Tree& tree, const std::string& treeName, std::size_t leafSize,
+                                   std::vector<Point> dataVec, std::vector<Query>& queryVec, uint32_t range) {
+    tree.set_leaf_size(leafSize);
+
+    long long int startTime = now_us();
+    tree.construct_tree(dataVec, false);
+    long long int endTime = now_us();
+
+    spdlog::info("[ExperimentApp] Finish construction time testing on {} with leaf size={}, data length={}, running "
+                 "time={}", treeName, leafSize, N, endTime - startTime);
+
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+
+    for (auto& query : queryVec) {
+        startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        endTime = now_us();
+
+        sum_time = sum_time + (endTime - startTime);
+        sum_k = sum_k + result.size();
+    }
+
+    spdlog::info("[ExperimentApp] Finish query time testing on {} with leaf size={}, data length={}, range={}, k={}, "
+                 "running time={}", treeName, leafSize, N, range, sum_k / queryVec.size(),
+                 sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::query_time_query_threads(const std::vector<std::size_t>& threadCounts) {
+    spdlog::info("Start query time test of heavy queries with various number of threads per query");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    auto range = static_cast<uint32_t>(0.2 * N);
+    std::vector<Query> queryVec;
+    for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+        queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+    }
+
+    OrgRangeTree orgRangeTree;
+    orgRangeTree.set_secondary_layout(SecondaryLayout::Array);
+    orgRangeTree.construct_tree(dataVec, false);
+
+    FcRangeTree fcRangeTree;
+    fcRangeTree.construct_tree(dataVec, false);
+
+    for (auto numThreads : threadCounts) {
+        spdlog::info("Start with number of threads={}", numThreads);
+
+        orgRangeTree.set_query_threads(numThreads);
+        fcRangeTree.set_query_threads(numThreads);
+
+        query_threads_time(orgRangeTree, "Original Range Tree", numThreads, queryVec, range);
+        query_threads_time(fcRangeTree, "Fractional Cascading Range Tree", numThreads, queryVec, range);
+    }
+}
+
+void ExperimentApp::query_threads_time(IRangeTree& tree, const std::string& treeName, std::size_t numThreads,
+                                       std::vector<Query>& queryVec, uint32_t range) {
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+
+    for (auto& query : queryVec) {
+        long long int startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        long long int endTime = now_us();
+
+        sum_time = sum_time + (endTime - startTime);
+        sum_k = sum_k + result.size();
+    }
+
+    spdlog::info("[ExperimentApp] Finish query time testing on {} with threads={}, data length={}, range={}, k={}, "
+                 "running time={}", treeName, numThreads, N, range, sum_k / queryVec.size(),
+                 sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::trace_construct_and_batch(uint32_t dataLen, const std::string& tracePath) {
+    spdlog::info("Start tracing construction and batch query of both trees with data length={}", dataLen);
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(dataLen);
+
+    std::vector<Query> queryVec;
+    for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+        queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.05 * N)));
+    }
+
+    Tracer& tracer = Tracer::shared();
+    tracer.clear();
+
+    // construct once without and once with tracing, so that its overhead shows up
+    for (bool enabled : {false, true}) {
+        tracer.set_enabled(enabled);
+
+        OrgRangeTree orgRangeTree;
+        orgRangeTree.set_sort_backend(SortBackend::Radix);
+
+        std::vector<Point> org_copy{dataVec};
+        long long int startTime = now_us();
+        orgRangeTree.construct_tree(org_copy, false);
+        long long int endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish construction time testing on Original Range Tree with tracing={}, data "
+                     "length={}, running time={}", enabled, dataLen, endTime - startTime);
+
+        FcRangeTree fcRangeTree;
+        fcRangeTree.set_sort_backend(SortBackend::Radix);
+
+        std::vector<Point> fc_copy{dataVec};
+        startTime = now_us();
+        fcRangeTree.construct_tree(fc_copy, false);
+        endTime = now_us();
+
+        spdlog::info("[ExperimentApp] Finish construction time testing on Fractional Cascading Range Tree with "
+                     "tracing={}, data length={}, running time={}", enabled, dataLen, endTime - startTime);
+
+        std::vector<std::vector<Point>> results;
+        fcRangeTree.report_points_batch(queryVec, results);
+    }
+
+    tracer.set_enabled(false);
+    tracer.dump_chrome_json(tracePath);
+
+    spdlog::info("[ExperimentApp] Finish tracing, trace written to {}", tracePath);
+}
+
+void ExperimentApp::query_time_cache_mode(const std::vector<double>& queryRangePers, std::size_t numInstances) {
+    spdlog::info("Start query time test in warm and cold cache states with various query range");
+
+    PlatformInfo info = platform_info();
+    CacheFlusher flusher(info.llcSize);
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    // several instances of each tree, their nodes are spread over more memory than the caches hold, the original
+    // range tree takes the array layout so that the instances fit in memory
+    std::vector<std::unique_ptr<OrgRangeTree>> orgRangeTrees;
+    std::vector<std::unique_ptr<FcRangeTree>> fcRangeTrees;
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(numInstances, 1); ++i) {
+        std::vector<Point> org_copy{dataVec}, fc_copy{dataVec};
+
+        orgRangeTrees.emplace_back(std::make_unique<OrgRangeTree>());
+        orgRangeTrees.back()->set_secondary_layout(SecondaryLayout::Array);
+        orgRangeTrees.back()->construct_tree(org_copy, false);
+
+        fcRangeTrees.emplace_back(std::make_unique<FcRangeTree>());
+        fcRangeTrees.back()->construct_tree(fc_copy, false);
+    }
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}, cpu{} frequency={}MHz", range, mTimingCpu,
+                     cpu_frequency_mhz(mTimingCpu));
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        cache_mode_time(orgRangeTrees, "Original Range Tree", queryVec, range, flusher);
+        cache_mode_time(fcRangeTrees, "Fractional Cascading Range Tree", queryVec, range, flusher);
+    }
+}
+
+template <typename Tree>
+void ExperimentApp::cache_mode_time(std::vector<std::unique_ptr<Tree>>& trees, const std::string& treeName,
+                                    std::vector<Query>& queryVec, uint32_t range, CacheFlusher& flusher) {
+    // only this thread, no thread is spawned while pinned, the previous CPUs are restored on return
+    ThreadPin pin(mTimingCpu);
+    if (!pin.pinned())
+        spdlog::warn("[ExperimentApp] Cannot pin to cpu {}, the cache modes run unpinned", mTimingCpu);
+
+    unsigned long long int sum_k = 0;
+
+    auto time_query = [&sum_k](Tree& tree, Query query) -> long long int {
+        long long int startTime = now_ns();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        long long int endTime = now_ns();
+
+        sum_k = sum_k + result.size();
+        return endTime - startTime;
+    };
+
+    auto log_mode = [&](const std::string& mode, long long int sum_time, std::size_t count) {
+        spdlog::info("[ExperimentApp] Finish query time testing on {} with cache mode={}, data length={}, range={}, "
+                     "k={}, running time={}ns", treeName, mode, N, range, sum_k / count,
+                     sum_time / static_cast<long long int>(count));
+        sum_k = 0;
+    };
+
+    // warm, after one untimed pass over the queries
+    long long int sum_time = 0;
+    for (auto& query : queryVec)
+        time_query(*trees[0], query);
+
+    sum_k = 0;
+    for (auto& query : queryVec)
+        sum_time = sum_time + time_query(*trees[0], query);
+
+    log_mode("warm", sum_time, queryVec.size());
+
+    // cold, the flush is not timed
+    sum_time = 0;
+    for (auto& query : queryVec) {
+        flusher.flush();
+        sum_time = sum_time + time_query(*trees[0], query);
+    }
+
+    log_mode("cold", sum_time, queryVec.size());
+
+    // rotating, the same query rarely meets the same instance twice in a row
+    std::vector<std::pair<std::size_t, std::size_t>> order;
+    for (std::size_t t = 0; t < trees.size(); ++t) {
+        for (std::size_t q = 0; q < queryVec.size(); ++q)
+            order.emplace_back(t, q);
+    }
+
+    std::mt19937 rng(static_cast<uint32_t>(queryVec.size()));
+    std::shuffle(order.begin(), order.end(), rng);
+
+    sum_time = 0;
+    for (auto [t, q] : order)
+        sum_time = sum_time + time_query(*trees[t], queryVec[q]);
+
+    log_mode("rotating", sum_time, order.size());
+}
+
+void ExperimentApp::query_time_approx_count(const std::vector<double>& queryRangePers, double epsilon,
+                                            std::size_t memoryBudget) {
+    spdlog::info("Start query time test of approximate counting with various query range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree fcRangeTree;
+    auto treeVec = dataVec;
+    fcRangeTree.construct_tree(treeVec, false);
+
+    ApproxCounter approxCounter(fcRangeTree, epsilon, memoryBudget);
+    approxCounter.build(dataVec);
+
+    // a count takes well under a microsecond, time many more queries than NUM_REPEAT
+    const std::size_t numQueries = 100 * NUM_REPEAT;
+
+    for (auto rangePer: queryRangePers) {
+        auto range = static_cast<uint32_t>(rangePer * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (std::size_t i = 0; i < numQueries; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        std::vector<std::size_t> exactCounts, approxCounts;
+        exactCounts.reserve(numQueries);
+        approxCounts.reserve(numQueries);
+
+        long long int startTime = now_ns();
+        for (auto& query : queryVec)
+            exactCounts.emplace_back(fcRangeTree.count_points(query));
+        long long int exactTime = now_ns() - startTime;
+
+        std::size_t fallbacks = approxCounter.fallbacks();
+        startTime = now_ns();
+        for (auto& query : queryVec)
+            approxCounts.emplace_back(approxCounter.count(query));
+        long long int approxTime = now_ns() - startTime;
+        fallbacks = approxCounter.fallbacks() - fallbacks;
+
+        // relative error of the non-empty queries
+        double sum_error = 0, max_error = 0;
+        unsigned long long int sum_k = 0;
+
+        for (std::size_t i = 0; i < numQueries; ++i) {
+            sum_k = sum_k + exactCounts[i];
+            if (exactCounts[i] == 0)
+                continue;
+
+            auto exact = static_cast<double>(exactCounts[i]);
+            double error = std::abs(static_cast<double>(approxCounts[i]) - exact) / exact;
+            sum_error = sum_error + error;
+            max_error = std::max(max_error, error);
+        }
+
+        spdlog::info("[ExperimentApp] Finish approximate count testing with data length={}, range={}, k={}, "
+                     "epsilon={}, grid bytes={}, exact time={}ns, approximate time={}ns, speedup={:.2f}, "
+                     "mean error={:.5f}, max error={:.5f}, fallbacks={}", N, range, sum_k / numQueries, epsilon,
+                     approxCounter.grid_bytes(), exactTime / static_cast<long long int>(numQueries),
+                     approxTime / static_cast<long long int>(numQueries),
+                     static_cast<double>(exactTime) / static_cast<double>(std::max(approxTime, 1LL)),
+                     sum_error / static_cast<double>(numQueries), max_error, fallbacks);
+    }
+}
+
+void ExperimentApp::construct_time_collapse(const std::vector<uint32_t>& universeSizes) {
+    spdlog::info("Start construction time test of collapsing duplicate coordinates with various universe size");
+
+    for (auto universe: universeSizes) {
+        spdlog::info("Start with universe size={}", universe);
+
+        mDataGenerator.set_range(1, universe);
+        auto dataVec = mDataGenerator.generate_point_set(N);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(static_cast<uint32_t>(0.05 * universe)));
+        }
+
+        collapse_time(false, dataVec, queryVec, universe);
+        collapse_time(true, dataVec, queryVec, universe);
+    }
+}
+
+void ExperimentApp::collapse_time(bool collapse, std::vector<Point> dataVec, std::vector<Query>& queryVec,
+                                  uint32_t universe) {
+    FcRangeTree tree;
+    tree.set_collapse_duplicates(collapse);
+
+    long long int startTime = now_us();
+    tree.construct_tree(dataVec, false);
+    long long int constructTime = now_us() - startTime;
+
+    std::size_t numNodes = 0, secBytes = 0;
+    tree.for_each_node([&numNodes, &secBytes](const FcRangeTreeNode* node) {
+        ++numNodes;
+        secBytes += node->secFCNodes.size() * sizeof(FcNode);
+    });
+
+    long long int sum_time = 0;
+    unsigned long long int sum_k = 0;
+
+    for (auto& query : queryVec) {
+        startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        sum_time = sum_time + (now_us() - startTime);
+        sum_k = sum_k + result.size();
+    }
+
+    spdlog::info("[ExperimentApp] Finish collapse testing on Fractional Cascading Range Tree with collapse={}, data "
+                 "length={}, universe={}, nodes={}, secondary arrays={} bytes, construction time={}, k={}, "
+                 "running time={}", collapse, dataVec.size(), universe, numNodes, secBytes, constructTime,
+                 sum_k / queryVec.size(), sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::query_latency_open_loop(const std::vector<double>& qpsRates, uint64_t latencyTargetUs,
+                                            const std::string& tracePath) {
+    spdlog::info("Start open-loop query latency test with various arrival rates");
+
+    if (qpsRates.empty())
+        return;
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    // the original range tree takes the array layout so that both trees fit in memory
+    OrgRangeTree orgRangeTree;
+    orgRangeTree.set_secondary_layout(SecondaryLayout::Array);
+    auto org_copy = dataVec;
+    orgRangeTree.construct_tree(org_copy, false);
+
+    FcRangeTree fcRangeTree;
+    auto fc_copy = dataVec;
+    fcRangeTree.construct_tree(fc_copy, false);
+
+    // go through the file, as a recorded trace would
+    QueryTrace::generate(mDataGenerator, 100 * NUM_REPEAT, static_cast<uint32_t>(0.01 * N), qpsRates.front())
+            .save(tracePath);
+    QueryTrace trace = QueryTrace::load(tracePath);
+
+    open_loop_latency(orgRangeTree, "Original Range Tree", trace, qpsRates, latencyTargetUs * 1000);
+    open_loop_latency(fcRangeTree, "Fractional Cascading Range Tree", trace, qpsRates, latencyTargetUs * 1000);
+}
+
+void ExperimentApp::open_loop_latency(IRangeTree& tree, const std::string& treeName, const QueryTrace& trace,
+                                      const std::vector<double>& qpsRates, uint64_t latencyTargetNs) {
+    QueryReplayer replayer(tree);
+
+    for (auto qps : qpsRates) {
+        ReplayResult result = replayer.replay(trace, qps);
+        const LatencyHistogram& latency = result.latency;
+
+        spdlog::info("[ExperimentApp] Finish open-loop latency testing on {} with data length={}, queries={}, offered "
+                     "qps={:.0f}, achieved qps={:.0f}, p50={}ns, p90={}ns, p99={}ns, p99.9={}ns, p99.99={}ns, "
+                     "max={}ns", treeName, N, trace.size(), result.offeredQps, result.achievedQps,
+                     latency.percentile(50), latency.percentile(90), latency.percentile(99), latency.percentile(99.9),
+                     latency.percentile(99.99), latency.max());
+    }
+
+    double maxQps = replayer.max_sustainable_qps(trace, 99, latencyTargetNs, qpsRates.front());
+
+    spdlog::info("[ExperimentApp] Finish sustainable rate testing on {} with data length={}, p99 target={}ns, "
+                 "max qps={:.0f}", treeName, N, latencyTargetNs, maxQps);
+}
+
+void ExperimentApp::query_locality_curve(const std::vector<double>& queryRangePers) {
+    spdlog::info("Start output locality test of renumbering points along space-filling curves with various query "
+                 "range");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    auto morton_copy = dataVec;
+    CurveRenumbering morton;
+    morton.renumber(morton_copy, CurveKind::Morton);
+
+    auto hilbert_copy = dataVec;
+    CurveRenumbering hilbert;
+    hilbert.renumber(hilbert_copy, CurveKind::Hilbert);
+
+    for (auto per : queryRangePers) {
+        uint32_t range = static_cast<uint32_t>(per * N);
+        spdlog::info("Start with query range={}", range);
+
+        std::vector<Query> queryVec;
+        for (unsigned int i = 0; i < NUM_REPEAT; ++i) {
+            queryVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        curve_locality("Generation", dataVec, queryVec);
+        curve_locality(to_string(CurveKind::Morton), morton_copy, queryVec);
+        curve_locality(to_string(CurveKind::Hilbert), hilbert_copy, queryVec);
+    }
+}
+
+void ExperimentApp::curve_locality(const std::string& orderName, std::vector<Point> dataVec,
+                                   std::vector<Query>& queryVec) {
+    // id-ordered coordinate columns, what an id-only secondary layout would look the reported ids up in
+    std::vector<uint32_t> xs(dataVec.size() + 1), ys(dataVec.size() + 1);
+    for (auto& point : dataVec) {
+        xs[point.id] = point.x;
+        ys[point.id] = point.y;
+    }
+
+    FcRangeTree tree;
+    tree.construct_tree(dataVec, false);
+
+    long long int sum_time = 0, sum_gather_time = 0;
+    unsigned long long int sum_k = 0, sum_runs = 0, sum_bytes = 0, checksum = 0;
+
+    for (auto& query : queryVec) {
+        long long int startTime = now_us();
+
+        std::vector<Point> result;
+        tree.report_points(query, result);
+
+        sum_time = sum_time + (now_us() - startTime);
+        sum_k = sum_k + result.size();
+
+        // gather in the order the tree reports, the order an id-only layout would hand the ids out
+        startTime = now_ns();
+        for (auto& point : result)
+            checksum += xs[point.id] + ys[point.id];
+        sum_gather_time = sum_gather_time + (now_ns() - startTime);
+
+        std::vector<uint32_t> ids;
+        ids.reserve(result.size());
+        for (auto& point : result)
+            ids.emplace_back(point.id);
+        std::sort(ids.begin(), ids.end());
+
+        // maximal runs of consecutive ids, and the LEB128 bytes of the gaps between sorted ids
+        uint32_t previous = 0;
+        for (auto id : ids) {
+            if (id != previous + 1)
+                ++sum_runs;
+
+            for (uint32_t delta = id - previous; delta >= 0x80; delta >>= 7)
+                ++sum_bytes;
+            ++sum_bytes;
+
+            previous = id;
+        }
+    }
+
+    spdlog::debug("[ExperimentApp] Gathered coordinates checksum={}", checksum);
+
+    spdlog::info("[ExperimentApp] Finish output locality testing on Fractional Cascading Range Tree with order={}, "
+                 "data length={}, k={}, id runs={}, bytes per id={:.2f}, gather time={}ns, running time={}",
+                 orderName, dataVec.size(), sum_k / queryVec.size(), sum_runs / queryVec.size(),
+                 sum_k == 0 ? 0.0 : static_cast<double>(sum_bytes) / static_cast<double>(sum_k),
+                 sum_gather_time / static_cast<long long int>(queryVec.size()),
+                 sum_time / static_cast<long long int>(queryVec.size()));
+}
+
+void ExperimentApp::query_time_delta(const std::vector<double>& panStepPers) {
+    spdlog::info("Start query time test of delta queries on panned queries with various pan step");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree tree;
+    tree.construct_tree(dataVec, false);
+
+    uint32_t range = static_cast<uint32_t>(0.05 * N);
+    std::mt19937 rng(1);
+
+    for (auto per : panStepPers) {
+        auto step = static_cast<uint32_t>(per * N);
+        spdlog::info("Start with pan step={}", step);
+
+        // a viewport of fixed size panned by step in a random direction along each axis, kept inside the data range
+        std::vector<Query> queryVec{Query(N / 2, N / 2 + range, N / 2, N / 2 + range)};
+        auto pan = [&rng, step, range](uint32_t lower) -> uint32_t {
+            if (rng() % 2 == 0)
+                return lower > step ? lower - step : 1;
+
+            return lower + step + range <= N ? lower + step : N - range;
+        };
+
+        for (unsigned int i = 1; i < NUM_REPEAT; ++i) {
+            uint32_t xLower = pan(queryVec.back().x_lower), yLower = pan(queryVec.back().y_lower);
+            queryVec.emplace_back(xLower, xLower + range, yLower, yLower + range);
+        }
+
+        long long int sum_full_time = 0, sum_delta_time = 0;
+        unsigned long long int sum_k = 0, sum_changed = 0;
+
+        for (std::size_t i = 1; i < queryVec.size(); ++i) {
+            long long int startTime = now_us();
+
+            std::vector<Point> result;
+            tree.report_points(queryVec[i], result);
+
+            sum_full_time = sum_full_time + (now_us() - startTime);
+            sum_k = sum_k + result.size();
+
+            startTime = now_us();
+
+            std::vector<Point> enteredPts, leftPts;
+            tree.report_delta(queryVec[i - 1], queryVec[i], enteredPts, leftPts);
+
+            sum_delta_time = sum_delta_time + (now_us() - startTime);
+            sum_changed = sum_changed + enteredPts.size() + leftPts.size();
+        }
+
+        auto numDeltas = static_cast<long long int>(queryVec.size() - 1);
+
+        spdlog::info("[ExperimentApp] Finish delta query testing on Fractional Cascading Range Tree with data "
+                     "length={}, query range={}, pan step={}, k={}, changed points={}, full query time={}, delta "
+                     "query time={}", N, range, step, sum_k / numDeltas, sum_changed / numDeltas,
+                     sum_full_time / numDeltas, sum_delta_time / numDeltas);
+    }
+}
+
+void ExperimentApp::query_time_batch_order(const std::vector<uint32_t>& queryCounts) {
+    spdlog::info("Start query time test of reordering query batches along the Hilbert curve with various number of "
+                 "queries");
+
+    mDataGenerator.set_range(1, N);
+    auto dataVec = mDataGenerator.generate_point_set(N);
+
+    FcRangeTree tree;
+    tree.construct_tree(dataVec, false);
+
+    uint32_t range = static_cast<uint32_t>(0.001 * N);
+    std::mt19937 rng(1);
+
+    for (auto numQueries : queryCounts) {
+        spdlog::info("Start with number of queries={}", numQueries);
+
+        std::vector<Query> randomVec;
+        for (unsigned int i = 0; i < numQueries; ++i) {
+            randomVec.emplace_back(mDataGenerator.generate_a_query(range));
+        }
+
+        // tiles of a map around a few hot spots, nearby queries are spread over the batch and many repeat
+        std::vector<std::pair<uint32_t, uint32_t>> centres;
+        for (unsigned int i = 0; i < 16; ++i) {
+            centres.emplace_back(static_cast<uint32_t>(1 + rng() % (N - 8 * range)),
+                                 static_cast<uint32_t>(1 + rng() % (N - 8 * range)));
+        }
+
+        std::vector<Query> clusteredVec;
+        for (unsigned int i = 0; i < numQueries; ++i) {
+            auto& centre = centres[rng() % centres.size()];
+            auto xLower = static_cast<uint32_t>(centre.first + rng() % 8 * range);
+            auto yLower = static_cast<uint32_t>(centre.second + rng() % 8 * range);
+            clusteredVec.emplace_back(xLower, xLower + range - 1, yLower, yLower + range - 1);
+        }
+
+        batch_order_time(tree, "random", randomVec);
+        batch_order_time(tree, "clustered", clusteredVec);
+    }
+}
+
+void ExperimentApp::batch_order_time(FcRangeTree& tree, const std::string& setName, std::vector<Query>& queryVec) {
+    for (bool reorder : {false, true}) {
+        tree.set_batch_reorder(reorder);
+
+        std::vector<std::vector<Point>> results;
+        long long int startTime = now_us();
+
+        tree.report_points_batch(queryVec, results);
+
+        long long int sum_time = now_us() - startTime;
+        unsigned long long int sum_k = 0;
+        for (auto& result : results)
+            sum_k = sum_k + result.size();
+
+        spdlog::info("[ExperimentApp] Finish batch order testing on Fractional Cascading Range Tree with data "
+                     "length={}, query set={}, queries={}, reorder={}, k={}, running time={}", N, setName,
+                     queryVec.size(), reorder, sum_k / queryVec.size(), sum_time);
+    }
+
+    tree.set_batch_reorder(true);
+}
+
+void ExperimentApp::describe_platform(std::size_t cpu) {
+    PlatformInfo info = platform_info();
+    mTimingCpu = cpu;
+
+    spdlog::info("[ExperimentApp] Platform cpu model={}, logical cpus={}, physical cores={}, packages={}, L1d={}KB, "
+                 "L2={}KB, LLC={}KB", info.cpuModel, info.logicalCpus, info.physicalCores, info.packages,
+                 info.l1dCacheSize >> 10, info.l2CacheSize >> 10, info.llcSize >> 10);
+    spdlog::info("[ExperimentApp] Timed single-thread loops pin to cpu {}, frequency={}MHz", cpu,
+                 cpu_frequency_mhz(cpu));
+}
+
 } // namespace ::Xiuge::RangeTree
\ No newline at end of file
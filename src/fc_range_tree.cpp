@@ -3,29 +3,166 @@
 //
 
 #include <spdlog/spdlog.h>
+#include <algorithm>
 #include <iostream>
+#include <queue>
+#include <tuple>
 
+#include "curve_order.h"
 #include "fc_range_tree.h"
+#include "thread_pool.h"
+#include "tracer.h"
+#include "utils.h"
 
 namespace Xiuge::RangeTree {
 
 namespace {
 
+// do not bother splitting the copy of the canonical runs for small answers
+const std::size_t MIN_POINTS_PER_COPY_THREAD = 1 << 14;
+
 inline bool in_range(Point pt, Query query) {
     return query.x_lower <= pt.x && pt.x <= query.x_upper
            && query.y_lower <= pt.y && pt.y <= query.y_upper;
 }
 
+// ascendingly by y, break tie by id
+inline bool y_less(const Point& a, const Point& b) {
+    return a.y == b.y ? a.id < b.id : a.y < b.y;
+}
+
+inline bool is_empty(Query query) {
+    return query.x_lower > query.x_upper || query.y_lower > query.y_upper;
 }
 
-void FcRangeTree::construct_tree(std::vector<Point>& points, bool ) {
+// split the part of from outside removed into at most four disjoint rectangles, the slabs left and right of removed
+// take the full height of from, the ones below and above it only the x range both share
+void subtract_query(Query from, Query removed, std::vector<Query>& pieces) {
+    if (is_empty(from))
+        return;
+
+    if (is_empty(removed) || removed.x_lower > from.x_upper || removed.x_upper < from.x_lower
+        || removed.y_lower > from.y_upper || removed.y_upper < from.y_lower) {
+        pieces.emplace_back(from);
+        return;
+    }
+
+    if (from.x_lower < removed.x_lower)
+        pieces.emplace_back(from.x_lower, removed.x_lower - 1, from.y_lower, from.y_upper);
+
+    if (from.x_upper > removed.x_upper)
+        pieces.emplace_back(removed.x_upper + 1, from.x_upper, from.y_lower, from.y_upper);
+
+    uint32_t xLower = std::max(from.x_lower, removed.x_lower), xUpper = std::min(from.x_upper, removed.x_upper);
+
+    if (from.y_lower < removed.y_lower)
+        pieces.emplace_back(xLower, xUpper, from.y_lower, removed.y_lower - 1);
+
+    if (from.y_upper > removed.y_upper)
+        pieces.emplace_back(xLower, xUpper, removed.y_upper + 1, from.y_upper);
+}
+
+// follow the cascading pointer of index i in node's secondary array to its left or right child, i may be past the end
+template <typename Node>
+inline std::size_t cascade(const Node* node, std::size_t i, bool toLeft) {
+    if (i < node->secFCNodes.size()) {
+        const auto& fcNode = node->secFCNodes[i];
+        return static_cast<std::size_t>(toLeft ? fcNode.successor_left : fcNode.successor_right);
+    }
+
+    return toLeft ? node->left->secFCNodes.size() : node->right->secFCNodes.size();
+}
+
+// position of the node in the x-sorted order, a leaf bucket takes the position of its smallest point
+template <typename Node>
+inline std::size_t rank_of(const Node* node) {
+    return static_cast<std::size_t>(node->index);
+}
+
+template <typename Node>
+inline bool is_leaf(const Node* node) {
+    return !node->left && !node->right;
+}
+
+// largest point of an internal node, the points after it go to the right subtree
+template <typename Node>
+inline const Point& last_point(const Node* node) {
+    return node->duplicates.empty() ? node->point : node->duplicates.back();
+}
+
+// append the point of an internal node if it is in range, or the run of its collapsed duplicates in the y range,
+// return the number of points appended
+template <typename Node>
+std::size_t report_node(const Node* node, Query query, std::vector<Point>& foundPts) {
+    const auto& duplicates = node->duplicates;
+
+    if (duplicates.empty()) {
+        if (!in_range(node->point, query))
+            return 0;
+
+        foundPts.emplace_back(node->point);
+        return 1;
+    }
+
+    if (node->point.x < query.x_lower || node->point.x > query.x_upper)
+        return 0;
+
+    auto begin = std::lower_bound(duplicates.begin(), duplicates.end(), query.y_lower,
+                                  [](const Point& point, uint32_t y) -> bool { return point.y < y; });
+    auto end = std::upper_bound(begin, duplicates.end(), query.y_upper,
+                                [](uint32_t y, const Point& point) -> bool { return y < point.y; });
+
+    foundPts.insert(foundPts.end(), begin, end);
+    return static_cast<std::size_t>(end - begin);
+}
+
+// append the points of secFCNodes[lower, upper) of the leaf, which are all in the y range, whose x is also in range,
+// return the number of points appended
+template <typename Node>
+std::size_t scan_leaf(const Node* leaf, std::size_t lower, std::size_t upper, Query query,
+                      std::vector<Point>& foundPts) {
+    const auto& secFCNodes = leaf->secFCNodes;
+    const auto& xs = leaf->bucketXs;
+    std::size_t before = foundPts.size();
+
+    for (std::size_t i = lower; i < upper; ++i) {
+        uint32_t x = xs.empty() ? secFCNodes[i].point.x : xs[i];
+
+        if (query.x_lower <= x && x <= query.x_upper)
+            foundPts.emplace_back(secFCNodes[i].point);
+    }
+
+    return foundPts.size() - before;
+}
+
+}
+
+template <typename Index>
+BasicFcRangeTree<Index>::~BasicFcRangeTree() {
+    stop_warm_up();
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::construct_tree(std::vector<Point>& points, bool ) {
+    TraceScope trace("FcRangeTree::construct_tree");
     spdlog::info("[FcRangeTree] Start factional-cascading range tree construction");
 
-    // in-place sort ascendingly by x, and then by y, break tie by id
-    sort(points.begin(), points.end());
+    stop_warm_up();
+
+    // ids are 32 bits and break ties of y, so the wider index types are bounded by them as well
+    if (unlikely(points.size() > max_index<Index>() || points.size() > std::numeric_limits<uint32_t>::max()))
+        throw std::runtime_error("[FcRangeTree] too many points for the index type, size=" +
+                                 std::to_string(points.size()));
+
+    // in-place sort ascendingly by x, and then by y, break tie by id, the buffer is reused by the second sort
+    std::vector<Point> sortBuffer;
+    sort_by_x(points, mSortBackend, sortBuffer);
 
     // build on first dimension
-    mRoot = build_tree(points, 0, static_cast<int>(points.size() - 1));
+    {
+        TraceScope buildTrace("FcRangeTree::build_tree");
+        mRoot = build_tree(points, 0, points.size(), mLeafSize, mCollapseDuplicates);
+    }
 
     // Uncomment if debug
     // spdlog::debug("[OrgRangeTree] Constructed tree in first dimension");
@@ -35,29 +172,61 @@ void FcRangeTree::construct_tree(std::vector<Point>& points, bool ) {
     spdlog::info("[FcRangeTree] Start secondary factional-cascading construction");
 
     // in-place sort ascendingly by y, break tie by id
-    sort(points.begin(), points.end(),
-         [](const Point& a, const Point& b) -> bool
-         {
-             return a.y == b.y ? a.id < b.id : a.y < b.y;
-         });
+    sort_by_y(points, mSortBackend, sortBuffer);
+
+    // leave everything to ensure_sec_dim_array
+    if (mLazy) {
+        mLazyPoints = points;
+        return;
+    }
+
+    TraceScope secTrace("FcRangeTree::build_sec_dim_array");
 
     for (auto point : points)
-        mRoot->secFCNodes.emplace_back(FcNode(point));
+        mRoot->secFCNodes.emplace_back(SecNode(point));
 
     build_sec_dim_array(mRoot.get());
 }
 
-std::unique_ptr<FcRangeTreeNode> FcRangeTree::build_tree(std::vector<Point>& points, const int start, const int end) {
-    if (start > end)
+template <typename Index>
+auto BasicFcRangeTree<Index>::build_tree(std::vector<Point>& points, std::size_t begin, std::size_t end,
+                                         std::size_t leafSize, bool collapse) -> std::unique_ptr<Node> {
+    if (begin >= end)
         return nullptr;
 
-    int mid = (start + end) / 2; // integer division
+    // stop at a leaf bucket, the primary tree keeps only its smallest point, the others live in its secondary array
+    if (end - begin <= leafSize || (collapse && points[begin].x == points[end - 1].x)) {
+        std::unique_ptr<Node> node(new Node(points[begin]));
+        node->index = static_cast<Index>(begin);
+        node->maxX = points[end - 1].x;
 
-    std::unique_ptr<FcRangeTreeNode> node(new FcRangeTreeNode(points[static_cast<unsigned long>(mid)]));
+        return node;
+    }
+
+    std::size_t mid = begin + (end - begin - 1) / 2; // lower middle
+    std::size_t midEnd = mid + 1;
+
+    // widen the middle to all the points of its x-coordinate, which are already sorted by y and then by id
+    if (collapse) {
+        auto x_less = [](const Point& a, const Point& b) -> bool { return a.x < b.x; };
+        auto first = points.begin() + static_cast<std::ptrdiff_t>(begin);
+        auto last = points.begin() + static_cast<std::ptrdiff_t>(end);
+
+        mid = static_cast<std::size_t>(std::lower_bound(first, last, points[mid], x_less) - points.begin());
+        midEnd = static_cast<std::size_t>(std::upper_bound(first, last, points[mid], x_less) - points.begin());
+    }
+
+    std::unique_ptr<Node> node(new Node(points[mid]));
+    node->index = static_cast<Index>(mid);
+    node->maxX = node->point.x;
+
+    if (midEnd - mid > 1)
+        node->duplicates.assign(points.begin() + static_cast<std::ptrdiff_t>(mid),
+                                points.begin() + static_cast<std::ptrdiff_t>(midEnd));
 
     // construct tree in only first dimension
-    node->left = build_tree(points, start, mid - 1);
-    node->right = build_tree(points, mid + 1, end);
+    node->left = build_tree(points, begin, mid, leafSize, collapse);
+    node->right = build_tree(points, midEnd, end, leafSize, collapse);
 
     // assign parent to each children
     if (node->left)
@@ -69,26 +238,32 @@ std::unique_ptr<FcRangeTreeNode> FcRangeTree::build_tree(std::vector<Point>& poi
     return node;
 }
 
-void FcRangeTree::build_sec_dim_array(FcRangeTreeNode* node) {
+template <typename Index>
+void BasicFcRangeTree<Index>::build_sec_dim_array(Node* node) {
     if (node == nullptr || node->secFCNodes.empty())
         return;
 
-    int succ_left = 0, succ_right = 0;
+    if (is_leaf(node)) {
+        link_sec_dim_array(node);
+        return;
+    }
+
+    std::size_t succ_left = 0, succ_right = 0;
 
     for (auto& secNode : node->secFCNodes) {
-        secNode.successor_left = succ_left;
-        secNode.successor_right = succ_right;
+        secNode.successor_left = static_cast<Index>(succ_left);
+        secNode.successor_right = static_cast<Index>(succ_right);
 
         if (node->left) {
             if (secNode.point < node->point) {
-                node->left->secFCNodes.emplace_back(FcNode(secNode.point));
+                node->left->secFCNodes.emplace_back(SecNode(secNode.point));
                 ++succ_left;
             }
         }
 
         if (node->right) {
-            if (secNode.point > node->point) {
-                node->right->secFCNodes.emplace_back(FcNode(secNode.point));
+            if (secNode.point > last_point(node)) {
+                node->right->secFCNodes.emplace_back(SecNode(secNode.point));
                 ++succ_right;
             }
         }
@@ -105,118 +280,693 @@ void FcRangeTree::build_sec_dim_array(FcRangeTreeNode* node) {
     build_sec_dim_array(node->right.get());
 }
 
-void FcRangeTree::report_points(Query query, std::vector<Point>& foundPts) {
-    FcRangeTreeNode* node = mRoot.get();
+template <typename Index>
+void BasicFcRangeTree<Index>::ensure_sec_dim_array(Node* node) {
+    if (!mLazy)
+        return;
+
+    std::call_once(node->secOnce, [this, node] {
+        auto& secFCNodes = node->secFCNodes;
+        Node* parent = node->parent;
+
+        // take the points from the parent, keeping the order by y, exactly as build_sec_dim_array distributes them
+        if (parent == nullptr) {
+            secFCNodes.reserve(mLazyPoints.size());
+            for (auto point : mLazyPoints)
+                secFCNodes.emplace_back(SecNode(point));
+
+            mLazyPoints = std::vector<Point>();
+        }
+        else {
+            ensure_sec_dim_array(parent);
+            bool isLeft = parent->left.get() == node;
+
+            for (auto& parentNode : parent->secFCNodes) {
+                if (isLeft ? parentNode.point < parent->point : parentNode.point > last_point(parent))
+                    secFCNodes.emplace_back(SecNode(parentNode.point));
+            }
+        }
+
+        // link to the children, whose arrays do not need to exist yet
+        link_sec_dim_array(node);
+    });
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::link_sec_dim_array(Node* node) {
+    auto& secFCNodes = node->secFCNodes;
+
+    if (is_leaf(node)) {
+        // a single point is checked directly, a bucket gets its x column for the scan
+        if (secFCNodes.size() > 1) {
+            node->bucketXs.reserve(secFCNodes.size());
+            for (auto& secNode : secFCNodes)
+                node->bucketXs.emplace_back(secNode.point.x);
+        }
+
+        return;
+    }
+
+    std::size_t succ_left = 0, succ_right = 0;
+
+    for (auto& secNode : secFCNodes) {
+        secNode.successor_left = static_cast<Index>(succ_left);
+        secNode.successor_right = static_cast<Index>(succ_right);
+
+        if (node->left && secNode.point < node->point)
+            ++succ_left;
+
+        if (node->right && secNode.point > last_point(node))
+            ++succ_right;
+    }
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::warm_up_async() {
+    if (!mLazy || !mRoot)
+        return;
+
+    stop_warm_up();
+    mStopWarming = false;
+
+    mWarmer = std::thread([this] {
+        std::queue<Node*> nodes;
+        nodes.push(mRoot.get());
+
+        // breadth first, so that nodes near the root, which are shared by most queries, are built first
+        while (!nodes.empty() && !mStopWarming) {
+            Node* node = nodes.front();
+            nodes.pop();
+
+            ensure_sec_dim_array(node);
+
+            if (node->left)
+                nodes.push(node->left.get());
+
+            if (node->right)
+                nodes.push(node->right.get());
+        }
+    });
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::stop_warm_up() {
+    mStopWarming = true;
+
+    if (mWarmer.joinable())
+        mWarmer.join();
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    report_points_impl<false>(query, foundPts, limit, nullptr);
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_points(Query query, std::vector<Point>& foundPts, QueryStats& stats,
+                                            std::size_t limit) {
+    report_points_impl<true>(query, foundPts, limit, &stats);
+}
+
+template <typename Index>
+template <bool CollectStats>
+void BasicFcRangeTree<Index>::report_points_impl(Query query, std::vector<Point>& foundPts, std::size_t limit,
+                                                 QueryStats* stats) {
+    std::vector<Run> runs;
+    std::size_t before = foundPts.size();
+    find_canonical_impl<CollectStats>(query, foundPts, runs, stats);
+
+    if (foundPts.size() - before >= limit) {
+        foundPts.resize(before + limit);
+        return;
+    }
+
+    copy_runs(runs, foundPts, limit - (foundPts.size() - before));
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::copy_runs(const std::vector<Run>& runs, std::vector<Point>& foundPts,
+                                        std::size_t limit) const {
+    // output offset of each run, the runs past the limit are cut
+    std::vector<std::size_t> offsets{0};
+    offsets.reserve(runs.size() + 1);
+
+    for (std::size_t r = 0; r < runs.size() && offsets.back() < limit; ++r)
+        offsets.push_back(offsets.back() + std::min(runs[r].end - runs[r].begin, limit - offsets.back()));
+
+    std::size_t total = offsets.back(), numRuns = offsets.size() - 1;
+    std::size_t numSlices = std::min(mQueryThreads, total / MIN_POINTS_PER_COPY_THREAD);
+
+    if (numSlices <= 1) {
+        for (std::size_t r = 0; r < numRuns; ++r) {
+            auto& secFCNodes = runs[r].node->secFCNodes;
+            auto end = runs[r].begin + (offsets[r + 1] - offsets[r]);
+
+            for (auto i = runs[r].begin; i < end; ++i)
+                foundPts.emplace_back(secFCNodes[i].point);
+        }
+
+        return;
+    }
+
+    // every slice copies an equal share of the output, starting in the middle of whichever run covers it
+    std::size_t base = foundPts.size();
+    foundPts.resize(base + total);
+    Point* out = foundPts.data() + base;
+
+    ThreadPool::shared().parallel_for(numSlices, [&](std::size_t s) {
+        TraceScope trace("FcRangeTree::copy_runs slice");
+        std::size_t pos = s * total / numSlices, end = (s + 1) * total / numSlices;
+        std::size_t r = static_cast<std::size_t>(std::upper_bound(offsets.begin(), offsets.end(), pos)
+                                                 - offsets.begin()) - 1;
+
+        for (; pos < end; ++r) {
+            const SecNode* run = runs[r].node->secFCNodes.data() + runs[r].begin;
+            std::size_t runEnd = std::min(offsets[r + 1], end);
+
+            for (; pos < runEnd; ++pos)
+                out[pos] = run[pos - offsets[r]].point;
+        }
+    });
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_lowest_y(Query query, std::size_t k, std::vector<Point>& foundPts) {
+    std::vector<Point> pathPts;
+    std::vector<Run> runs;
+    find_canonical(query, pathPts, runs);
+
+    // path points form one more y-sorted run, each heap entry is the head of a run: (head point, run index, position)
+    std::sort(pathPts.begin(), pathPts.end(), y_less);
+
+    using Head = std::tuple<Point, std::size_t, std::size_t>;
+    auto head_greater = [](const Head& a, const Head& b) -> bool { return y_less(std::get<0>(b), std::get<0>(a)); };
+    std::priority_queue<Head, std::vector<Head>, decltype(head_greater)> heap(head_greater);
+
+    if (!pathPts.empty())
+        heap.emplace(pathPts[0], runs.size(), 0);
+
+    for (std::size_t r = 0; r < runs.size(); ++r)
+        heap.emplace(runs[r].node->secFCNodes[runs[r].begin].point, r, runs[r].begin);
+
+    while (k > 0 && !heap.empty()) {
+        auto [point, r, pos] = heap.top();
+        heap.pop();
+
+        foundPts.emplace_back(point);
+        --k;
+
+        ++pos;
+        if (r == runs.size()) {
+            if (pos < pathPts.size())
+                heap.emplace(pathPts[pos], r, pos);
+        }
+        else if (pos < runs[r].end)
+            heap.emplace(runs[r].node->secFCNodes[pos].point, r, pos);
+    }
+}
+
+template <typename Index>
+std::size_t BasicFcRangeTree<Index>::count_points(Query query) {
+    std::vector<Point> pathPts;
+    std::vector<Run> runs;
+    find_canonical(query, pathPts, runs);
+
+    std::size_t count = pathPts.size();
+    for (auto& run : runs)
+        count += run.end - run.begin;
+
+    return count;
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_delta(Query previous, Query query, std::vector<Point>& enteredPts,
+                                           std::vector<Point>& leftPts) {
+    std::vector<Query> pieces;
+
+    subtract_query(query, previous, pieces);
+    for (auto& piece : pieces)
+        report_points(piece, enteredPts);
+
+    pieces.clear();
+
+    subtract_query(previous, query, pieces);
+    for (auto& piece : pieces)
+        report_points(piece, leftPts);
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::find_canonical(Query query, std::vector<Point>& pathPts, std::vector<Run>& runs) {
+    find_canonical_impl<false>(query, pathPts, runs, nullptr);
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::for_each_node(const std::function<void(const Node*)>& visitor) {
+    std::vector<Node*> nodes;
+    if (mRoot)
+        nodes.push_back(mRoot.get());
+
+    while (!nodes.empty()) {
+        Node* node = nodes.back();
+        nodes.pop_back();
+
+        ensure_sec_dim_array(node);
+        visitor(node);
+
+        if (node->right)
+            nodes.push_back(node->right.get());
+
+        if (node->left)
+            nodes.push_back(node->left.get());
+    }
+}
+
+template <typename Index>
+template <bool CollectStats>
+void BasicFcRangeTree<Index>::find_canonical_impl(Query query, std::vector<Point>& pathPts, std::vector<Run>& runs,
+                                                  QueryStats* stats) {
+    Node* node = mRoot.get();
 
     // find the successor of x_min and the predecessor of x_max
-    FcRangeTreeNode* succ_min = tree_search(node, query.x_lower, true);
-    FcRangeTreeNode* pred_max = tree_search(node, query.x_upper, false);
+    Node* succ_min = tree_search<CollectStats>(node, query.x_lower, true, stats);
+    Node* pred_max = tree_search<CollectStats>(node, query.x_upper, false, stats);
 
     // none of points are in range
-    if (succ_min == nullptr || pred_max == nullptr || succ_min->point.x > pred_max->point.x)
+    if (succ_min == nullptr || pred_max == nullptr || rank_of(succ_min) > rank_of(pred_max))
         return;
 
     // find the lowest common ancestor of succ_min and pred_max
-    FcRangeTreeNode* lca = find_lca(node, succ_min, pred_max);
+    Node* lca = find_lca<CollectStats>(node, succ_min, pred_max, stats);
+
+    // return lca if it is in range, a leaf is scanned below instead
+    if (!is_leaf(lca)) {
+        if (report_node(lca, query, pathPts) == 0) {
+            if constexpr (CollectStats)
+                ++stats->rangeRejections;
+        }
+    }
+
+    ensure_sec_dim_array(lca);
+
+    // find the successor of y_min and the successor of y_max, the points in between are the ones in the y range
+    std::size_t lower = vector_search(lca->secFCNodes, query.y_lower, true);
+    std::size_t upper = query.y_upper == UINT32_MAX ? lca->secFCNodes.size()
+                                                    : vector_search(lca->secFCNodes, query.y_upper + 1, true);
 
-    // return lca if it is in range
-    if (in_range(lca->point, query))
-        foundPts.emplace_back(lca->point);
+    if constexpr (CollectStats)
+        stats->secondarySearches += 2;
 
-    // find the successor of y_min
-    int index_succ_y_min = vector_search(lca->secFCNodes, query.y_lower, true);
+    // both targets are this leaf
+    if (is_leaf(lca)) {
+        std::size_t found = scan_leaf(lca, lower, std::max(lower, upper), query, pathPts);
 
-    if (index_succ_y_min < 0)
+        if constexpr (CollectStats)
+            stats->rangeRejections += std::max(lower, upper) - lower - found;
+
+        return;
+    }
+
+    if (lower == lca->secFCNodes.size())
         return;
 
-    FcRangeTreeNode* tree_iter = nullptr;
+    if (lca != succ_min)
+        walk_path<CollectStats>(lca, succ_min, query, lower, upper, true, pathPts, runs, stats);
+
+    if (lca != pred_max)
+        walk_path<CollectStats>(lca, pred_max, query, lower, upper, false, pathPts, runs, stats);
+}
+
+template <typename Index>
+template <bool CollectStats>
+void BasicFcRangeTree<Index>::walk_path(Node* lca, Node* target, Query query, std::size_t lower, std::size_t upper,
+                                        bool toSucc, std::vector<Point>& pathPts, std::vector<Run>& runs,
+                                        QueryStats* stats) {
+    PathWalk walk{lca, target, lower, upper, toSucc, toSucc};
+
+    while (walk_step<CollectStats>(walk, query, pathPts, runs, stats));
+}
+
+template <typename Index>
+template <bool CollectStats>
+bool BasicFcRangeTree<Index>::walk_step(PathWalk& walk, Query query, std::vector<Point>& pathPts,
+                                        std::vector<Run>& runs, QueryStats* stats) {
+    Node* tree_iter = walk.node;
+    Node* target = walk.target;
+    bool toLeft = walk.toLeft, toSucc = walk.toSucc;
 
     // For each node u other than lca on the path from lca to succ_min, add it if it is in range.
-    // If first dimention and succ_min.x <= u.x, then report all the points in u’s right sub-tree whose y-coordinates
-    // are in [y_lower, y_upper] in the secondary tree;
-    if (lca->point.id != succ_min->point.id) {
-        tree_iter = lca->left.get();
-        int start_index = lca->secFCNodes[static_cast<unsigned long>(index_succ_y_min)].successor_left;
-        FcNode start_node = tree_iter->secFCNodes[static_cast<unsigned long>(start_index)];
-
-        while(true) {
-            if (in_range(tree_iter->point, query))
-                foundPts.emplace_back(tree_iter->point);
-
-            if (succ_min->point.x <= tree_iter->point.x && tree_iter->right) {
-                auto i = static_cast<unsigned long>(start_node.successor_right);
-                auto size = tree_iter->right->secFCNodes.size();
-
-                while(i < size && tree_iter->right->secFCNodes[i].point.y <= query.y_upper) {
-                    foundPts.emplace_back(tree_iter->right->secFCNodes[i].point);
-                    ++i;
+    // If succ_min.x <= u.x, then the points in u’s right sub-tree whose y-coordinates are in [y_lower, y_upper] is a
+    // canonical run; symmetrically on the path to pred_max with u’s left sub-tree if pred_max.x >= u.x.
+    ensure_sec_dim_array(toLeft ? tree_iter->left.get() : tree_iter->right.get());
+
+    std::size_t lower = cascade(tree_iter, walk.lower, toLeft);
+    std::size_t upper = cascade(tree_iter, walk.upper, toLeft);
+    tree_iter = toLeft ? tree_iter->left.get() : tree_iter->right.get();
+
+    walk.node = tree_iter;
+    walk.lower = lower;
+    walk.upper = upper;
+
+    if constexpr (CollectStats) {
+        ++stats->primaryNodes;
+        stats->cascadeHops += 2;
+    }
+
+    // no point below has y-coordinate in range
+    if (lower >= upper)
+        return false;
+
+    // the walk ends at a leaf, which is the target, its points in the y range are checked for the x range
+    if (is_leaf(tree_iter)) {
+        std::size_t found = scan_leaf(tree_iter, lower, upper, query, pathPts);
+
+        if constexpr (CollectStats)
+            stats->rangeRejections += upper - lower - found;
+
+        return false;
+    }
+
+    if (report_node(tree_iter, query, pathPts) == 0) {
+        if constexpr (CollectStats)
+            ++stats->rangeRejections;
+    }
+
+    if ((toSucc && rank_of(target) <= rank_of(tree_iter) && tree_iter->right)
+        || (!toSucc && rank_of(target) >= rank_of(tree_iter) && tree_iter->left)) {
+        // the canonical subtree is on the opposite side of the walking direction
+        ensure_sec_dim_array(toSucc ? tree_iter->right.get() : tree_iter->left.get());
+        std::size_t begin = cascade(tree_iter, lower, !toSucc), end = cascade(tree_iter, upper, !toSucc);
+
+        if constexpr (CollectStats)
+            stats->cascadeHops += 2;
+
+        if (begin < end) {
+            runs.push_back({toSucc ? tree_iter->right.get() : tree_iter->left.get(), begin, end});
+
+            if constexpr (CollectStats)
+                ++stats->canonicalSubtrees;
+        }
+    }
+
+    if (target == tree_iter)
+        return false;
+
+    walk.toLeft = rank_of(target) < rank_of(tree_iter);
+    return true;
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_points_batch(const std::vector<Query>& queries,
+                                                  std::vector<std::vector<Point>>& results, std::size_t groupSize) {
+    TraceScope trace("FcRangeTree::report_points_batch");
+
+    results.resize(queries.size());
+    groupSize = std::max<std::size_t>(groupSize, 1);
+
+    if (!mBatchReorder) {
+        for (std::size_t start = 0; start < queries.size(); start += groupSize)
+            report_points_group(queries.data() + start, results.data() + start,
+                                std::min(groupSize, queries.size() - start));
+
+        return;
+    }
+
+    // sort by the curve position of the centre, then by the bounds so that identical queries become adjacent
+    auto bounds = [](const Query& query) {
+        return std::make_tuple(query.x_lower, query.x_upper, query.y_lower, query.y_upper);
+    };
+
+    std::vector<std::pair<uint64_t, std::size_t>> order(queries.size());
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        const Query& query = queries[i];
+        auto centreX = static_cast<uint32_t>((uint64_t{query.x_lower} + query.x_upper) / 2);
+        auto centreY = static_cast<uint32_t>((uint64_t{query.y_lower} + query.y_upper) / 2);
+        order[i] = {hilbert_index(centreX, centreY), i};
+    }
+
+    std::sort(order.begin(), order.end(), [&queries, &bounds](const auto& a, const auto& b) -> bool {
+        if (a.first != b.first)
+            return a.first < b.first;
+
+        auto aBounds = bounds(queries[a.second]), bBounds = bounds(queries[b.second]);
+        return aBounds == bBounds ? a.second < b.second : aBounds < bBounds;
+    });
+
+    // distinct queries in curve order, and the one each query of the batch is answered by
+    std::vector<Query> distinct;
+    std::vector<std::size_t> slots(queries.size());
+
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        const Query& query = queries[order[i].second];
+
+        if (i == 0 || bounds(query) != bounds(distinct.back()))
+            distinct.emplace_back(query);
+
+        slots[order[i].second] = distinct.size() - 1;
+    }
+
+    std::vector<std::vector<Point>> distinctResults(distinct.size());
+
+    for (std::size_t start = 0; start < distinct.size(); start += groupSize)
+        report_points_group(distinct.data() + start, distinctResults.data() + start,
+                            std::min(groupSize, distinct.size() - start));
+
+    // copy to every query but the last one answered by a distinct result, which takes it over
+    std::vector<std::size_t> remaining(distinct.size(), 0);
+    for (auto slot : slots)
+        ++remaining[slot];
+
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        std::vector<Point>& distinctResult = distinctResults[slots[i]];
+
+        if (--remaining[slots[i]] == 0 && results[i].empty())
+            results[i].swap(distinctResult);
+        else
+            results[i].insert(results[i].end(), distinctResult.begin(), distinctResult.end());
+    }
+
+    spdlog::debug("[FcRangeTree] Answered a batch of {} queries with {} distinct ones in Hilbert order",
+                  queries.size(), distinct.size());
+}
+
+template <typename Index>
+void BasicFcRangeTree<Index>::report_points_group(const Query* queries, std::vector<Point>* results,
+                                                  std::size_t count) {
+    TraceScope trace("FcRangeTree::report_points_group");
+
+    // state of one query of the group, every round below advances each query still in a phase by one step
+    struct Cursor {
+        Node* succIter;
+        Node* predIter;
+        Node* succ;
+        Node* pred;
+        Node* lca;
+        // binary search bounds in lca's secondary array, of the first y >= y_lower and of the first y > y_upper
+        std::size_t lowerBegin, lowerEnd;
+        std::size_t upperBegin, upperEnd;
+        PathWalk walk;
+        bool walking;
+        std::vector<Run> runs;
+    };
+
+    Node* root = mRoot.get();
+    std::vector<Cursor> cursors(count);
+
+    for (auto& cursor : cursors) {
+        cursor.succIter = cursor.predIter = root;
+        cursor.succ = cursor.pred = cursor.lca = nullptr;
+        cursor.walking = false;
+    }
+
+    // find the successor of x_min and the predecessor of x_max
+    for (bool active = root != nullptr; active;) {
+        active = false;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            Cursor& cursor = cursors[i];
+
+            if (cursor.succIter) {
+                if (cursor.succIter->maxX >= queries[i].x_lower) {
+                    cursor.succ = cursor.succIter;
+                    cursor.succIter = cursor.succIter->left.get();
                 }
+                else
+                    cursor.succIter = cursor.succIter->right.get();
+
+                __builtin_prefetch(cursor.succIter);
+                active |= cursor.succIter != nullptr;
             }
 
-            if (succ_min->point == tree_iter->point)
-                break;
-            else if (succ_min->point < tree_iter->point) {
-                start_index = start_node.successor_left;
-                tree_iter = tree_iter->left.get();
+            if (cursor.predIter) {
+                if (cursor.predIter->point.x <= queries[i].x_upper) {
+                    cursor.pred = cursor.predIter;
+                    cursor.predIter = cursor.predIter->right.get();
+                }
+                else
+                    cursor.predIter = cursor.predIter->left.get();
+
+                __builtin_prefetch(cursor.predIter);
+                active |= cursor.predIter != nullptr;
             }
-            else {
-                start_index = start_node.successor_right;
-                tree_iter = tree_iter->right.get();
+        }
+    }
+
+    // find the lowest common ancestor of succ_min and pred_max, reuse succIter as the cursor
+    bool active = false;
+
+    for (auto& cursor : cursors) {
+        bool empty = cursor.succ == nullptr || cursor.pred == nullptr || rank_of(cursor.succ) > rank_of(cursor.pred);
+        cursor.succIter = empty ? nullptr : root;
+        active |= !empty;
+    }
+
+    while (active) {
+        active = false;
+
+        for (auto& cursor : cursors) {
+            Node* tree_iter = cursor.succIter;
+            if (tree_iter == nullptr)
+                continue;
+
+            std::size_t rank = rank_of(tree_iter);
+
+            if (tree_iter == cursor.succ || tree_iter == cursor.pred
+                || (rank >= rank_of(cursor.succ) && rank <= rank_of(cursor.pred))) {
+                cursor.lca = tree_iter;
+                cursor.succIter = nullptr;
+                continue;
             }
 
-            if (static_cast<unsigned long>(start_index) < tree_iter->secFCNodes.size())
-                start_node = tree_iter->secFCNodes[static_cast<unsigned long>(start_index)];
-            else
-                break;
+            cursor.succIter = rank > rank_of(cursor.pred) ? tree_iter->left.get() : tree_iter->right.get();
+            __builtin_prefetch(cursor.succIter);
+            active = true;
         }
     }
 
-    // for each node u other than lca on the path from lca to pred_max, add it if it is in range
-    // If first dimention and pred_max.x >= u.x, then report all the points in u’s left sub-tree whose y-coordinates
-    // are in [y_lower, y_upper] in the secondary tree;
-    if (lca->point.id != pred_max->point.id) {
-        tree_iter = lca->right.get();
-        int start_index = lca->secFCNodes[static_cast<unsigned long>(index_succ_y_min)].successor_right;
-        FcNode start_node = tree_iter->secFCNodes[static_cast<unsigned long>(start_index)];
+    // binary search the y range in lca's secondary array
+    for (std::size_t i = 0; i < count; ++i) {
+        Cursor& cursor = cursors[i];
+        if (cursor.lca == nullptr)
+            continue;
 
-        while (true) {
-            if (in_range(tree_iter->point, query))
-                foundPts.emplace_back(tree_iter->point);
+        if (!is_leaf(cursor.lca))
+            report_node(cursor.lca, queries[i], results[i]);
 
-            if (pred_max->point.x >= tree_iter->point.x && tree_iter->left) {
-                auto i = static_cast<unsigned long>(start_node.successor_left);
-                auto size = tree_iter->left->secFCNodes.size();
+        ensure_sec_dim_array(cursor.lca);
 
-                while (i < size  && tree_iter->left->secFCNodes[i].point.y <= query.y_upper) {
-                    foundPts.emplace_back(tree_iter->left->secFCNodes[i].point);
-                    ++i;
-                }
+        cursor.lowerBegin = cursor.upperBegin = 0;
+        cursor.lowerEnd = cursor.upperEnd = cursor.lca->secFCNodes.size();
+        __builtin_prefetch(cursor.lca->secFCNodes.data() + cursor.lowerEnd / 2);
+        active = true;
+    }
+
+    while (active) {
+        active = false;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            Cursor& cursor = cursors[i];
+            if (cursor.lca == nullptr)
+                continue;
+
+            const SecNode* secFCNodes = cursor.lca->secFCNodes.data();
+
+            if (cursor.lowerBegin < cursor.lowerEnd) {
+                std::size_t mid = (cursor.lowerBegin + cursor.lowerEnd) / 2;
+
+                if (secFCNodes[mid].point.y >= queries[i].y_lower)
+                    cursor.lowerEnd = mid;
+                else
+                    cursor.lowerBegin = mid + 1;
+
+                __builtin_prefetch(secFCNodes + (cursor.lowerBegin + cursor.lowerEnd) / 2);
+                active |= cursor.lowerBegin < cursor.lowerEnd;
             }
 
-            if (pred_max->point == tree_iter->point)
-                break;
-            else if (pred_max->point < tree_iter->point) {
-                start_index = start_node.successor_left;
-                tree_iter = tree_iter->left.get();
-            } else {
-                start_index = start_node.successor_right;
-                tree_iter = tree_iter->right.get();
+            if (cursor.upperBegin < cursor.upperEnd) {
+                std::size_t mid = (cursor.upperBegin + cursor.upperEnd) / 2;
+
+                if (secFCNodes[mid].point.y > queries[i].y_upper)
+                    cursor.upperEnd = mid;
+                else
+                    cursor.upperBegin = mid + 1;
+
+                __builtin_prefetch(secFCNodes + (cursor.upperBegin + cursor.upperEnd) / 2);
+                active |= cursor.upperBegin < cursor.upperEnd;
             }
+        }
+    }
+
+    // walk toward succ_min first and then toward pred_max, carrying the cascaded y-indices
+    for (std::size_t i = 0; i < count; ++i) {
+        Cursor& cursor = cursors[i];
+        if (cursor.lca == nullptr || cursor.lowerBegin >= cursor.upperBegin)
+            continue;
+
+        // both targets are this leaf
+        if (is_leaf(cursor.lca)) {
+            scan_leaf(cursor.lca, cursor.lowerBegin, cursor.upperBegin, queries[i], results[i]);
+            continue;
+        }
+
+        if (cursor.lca != cursor.succ)
+            cursor.walk = {cursor.lca, cursor.succ, cursor.lowerBegin, cursor.upperBegin, true, true};
+        else if (cursor.lca != cursor.pred)
+            cursor.walk = {cursor.lca, cursor.pred, cursor.lowerBegin, cursor.upperBegin, false, false};
+        else
+            continue;
+
+        cursor.walking = true;
+        active = true;
+    }
 
-            if (static_cast<unsigned long>(start_index) < tree_iter->secFCNodes.size())
-                start_node = tree_iter->secFCNodes[static_cast<unsigned long>(start_index)];
+    while (active) {
+        active = false;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            Cursor& cursor = cursors[i];
+            if (!cursor.walking)
+                continue;
+
+            active = true;
+            PathWalk& walk = cursor.walk;
+
+            if (walk_step<false>(walk, queries[i], results[i], cursor.runs, nullptr)) {
+                // the next step reads the cascading pointers of both indices and then the child
+                const SecNode* secFCNodes = walk.node->secFCNodes.data();
+                __builtin_prefetch(secFCNodes + walk.lower);
+                __builtin_prefetch(secFCNodes + walk.upper);
+                __builtin_prefetch(walk.toLeft ? walk.node->left.get() : walk.node->right.get());
+            }
+            else if (walk.toSucc && cursor.lca != cursor.pred)
+                walk = {cursor.lca, cursor.pred, cursor.lowerBegin, cursor.upperBegin, false, false};
             else
-                break;
+                cursor.walking = false;
+        }
+    }
+
+    // copy the canonical runs
+    for (std::size_t i = 0; i < count; ++i) {
+        for (auto& run : cursors[i].runs) {
+            auto& secFCNodes = run.node->secFCNodes;
+
+            for (auto j = run.begin; j < run.end; ++j)
+                results[i].emplace_back(secFCNodes[j].point);
         }
     }
 }
 
-FcRangeTreeNode* FcRangeTree::tree_search(FcRangeTreeNode* node, uint32_t value, bool findSucc) {
-    FcRangeTreeNode* result = nullptr;
+template <typename Index>
+template <bool CollectStats>
+auto BasicFcRangeTree<Index>::tree_search(Node* node, uint32_t value, bool findSucc, QueryStats* stats) -> Node* {
+    Node* result = nullptr;
 
     if (findSucc) {
         while (node != nullptr) {
-            if (node->point.x >= value) {
+            if constexpr (CollectStats)
+                ++stats->primaryNodes;
+
+            // a leaf bucket holds the successor if any of its points does
+            if (node->maxX >= value) {
                 result = node;
                 node = node->left.get();
             }
@@ -226,6 +976,9 @@ FcRangeTreeNode* FcRangeTree::tree_search(FcRangeTreeNode* node, uint32_t value,
     }
     else {
         while (node != nullptr) {
+            if constexpr (CollectStats)
+                ++stats->primaryNodes;
+
             if (node->point.x <= value) {
                 result = node;
                 node = node->right.get();
@@ -238,47 +991,54 @@ FcRangeTreeNode* FcRangeTree::tree_search(FcRangeTreeNode* node, uint32_t value,
     return result;
 }
 
-int FcRangeTree::vector_search(std::vector<FcNode>& vector, uint32_t value, bool findSucc) {
-    int result = -1;
-    int upper = static_cast<int>(vector.size() - 1), lower = 0;
+template <typename Index>
+std::size_t BasicFcRangeTree<Index>::vector_search(const std::vector<SecNode>& vector, uint32_t value, bool findSucc) {
+    std::size_t result = vector.size();
+    std::size_t lower = 0, upper = vector.size();
 
     if (findSucc) {
-        while (upper > lower) {
-            int mid = (upper - lower) / 2 + lower;
+        while (lower < upper) {
+            std::size_t mid = lower + (upper - lower) / 2;
 
-            if (vector[static_cast<unsigned long>(mid)].point.y >= value) {
+            if (vector[mid].point.y >= value) {
                 result = mid;
-                upper = mid - 1;
+                upper = mid;
             }
             else
                 lower = mid + 1;
         }
     }
     else {
-        while (upper > lower) {
-            int mid = (upper - lower) / 2 + lower;
+        while (lower < upper) {
+            std::size_t mid = lower + (upper - lower) / 2;
 
-            if (vector[static_cast<unsigned long>(mid)].point.x <= value) {
+            if (vector[mid].point.y <= value) {
                 result = mid;
                 lower = mid + 1;
             }
             else
-                upper = mid - 1;
+                upper = mid;
         }
     }
 
     return result;
 }
 
-FcRangeTreeNode* FcRangeTree::find_lca(FcRangeTreeNode* node, FcRangeTreeNode* succ, FcRangeTreeNode* pred) {
-    FcRangeTreeNode* tree_iter = node;
+template <typename Index>
+template <bool CollectStats>
+auto BasicFcRangeTree<Index>::find_lca(Node* node, Node* succ, Node* pred, QueryStats* stats) -> Node* {
+    Node* tree_iter = node;
 
     while (tree_iter != nullptr) {
-        if (tree_iter->point == succ->point || tree_iter->point == pred->point)
+        if constexpr (CollectStats)
+            ++stats->primaryNodes;
+
+        if (tree_iter == succ || tree_iter == pred)
             return tree_iter;
 
-        if (tree_iter->point.x >= succ->point.x) {
-            if (tree_iter->point.x <= pred->point.x)
+        // compare by rank, a leaf bucket spans many x-coordinates
+        if (rank_of(tree_iter) >= rank_of(succ)) {
+            if (rank_of(tree_iter) <= rank_of(pred))
                 return tree_iter;
             else
                 tree_iter = tree_iter->left.get();
@@ -291,7 +1051,8 @@ FcRangeTreeNode* FcRangeTree::find_lca(FcRangeTreeNode* node, FcRangeTreeNode* s
     return nullptr;
 }
 
-void FcRangeTree::print_tree(FcRangeTreeNode* node, const int level) {
+template <typename Index>
+void BasicFcRangeTree<Index>::print_tree(Node* node, const int level) {
     if (node) {
         print_tree(node->right.get(), level + 1);
 
@@ -305,4 +1066,8 @@ void FcRangeTree::print_tree(FcRangeTreeNode* node, const int level) {
     }
 }
 
+template class BasicFcRangeTree<uint32_t>;
+template class BasicFcRangeTree<PackedIndex40>;
+template class BasicFcRangeTree<uint64_t>;
+
 } // namespace ::Xiuge::RangeTree
\ No newline at end of file
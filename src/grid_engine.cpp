@@ -0,0 +1,109 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "grid_engine.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// expected number of points in each cell
+const double POINTS_PER_CELL = 8.0;
+
+inline bool in_range(Point pt, Query query) {
+    return query.x_lower <= pt.x && pt.x <= query.x_upper
+           && query.y_lower <= pt.y && pt.y <= query.y_upper;
+}
+
+}
+
+void GridEngine::construct_tree(std::vector<Point>& points, bool ) {
+    mPoints.clear();
+    mCellStart.clear();
+    mCellsPerSide = 0;
+
+    if (points.empty())
+        return;
+
+    mMinX = mMaxX = points[0].x;
+    mMinY = mMaxY = points[0].y;
+
+    for (auto& point : points) {
+        mMinX = std::min(mMinX, point.x);
+        mMaxX = std::max(mMaxX, point.x);
+        mMinY = std::min(mMinY, point.y);
+        mMaxY = std::max(mMaxY, point.y);
+    }
+
+    mCellsPerSide = std::max<uint64_t>(1, static_cast<uint64_t>(std::sqrt(static_cast<double>(points.size()) / POINTS_PER_CELL)));
+    mCellWidthX = (static_cast<uint64_t>(mMaxX - mMinX) + mCellsPerSide) / mCellsPerSide;
+    mCellWidthY = (static_cast<uint64_t>(mMaxY - mMinY) + mCellsPerSide) / mCellsPerSide;
+
+    // counting sort points into cells
+    mCellStart.assign(mCellsPerSide * mCellsPerSide + 1, 0);
+
+    for (auto& point : points)
+        ++mCellStart[cell_of(point.y, mMinY, mCellWidthY) * mCellsPerSide + cell_of(point.x, mMinX, mCellWidthX) + 1];
+
+    for (std::size_t c = 1; c < mCellStart.size(); ++c)
+        mCellStart[c] += mCellStart[c - 1];
+
+    std::vector<std::size_t> fill(mCellStart.begin(), mCellStart.end() - 1);
+    mPoints.resize(points.size());
+
+    for (auto& point : points)
+        mPoints[fill[cell_of(point.y, mMinY, mCellWidthY) * mCellsPerSide + cell_of(point.x, mMinX, mCellWidthX)]++] = point;
+}
+
+void GridEngine::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    if (mPoints.empty() || query.x_lower > mMaxX || query.x_upper < mMinX || query.y_lower > mMaxY
+        || query.y_upper < mMinY || query.x_lower > query.x_upper || query.y_lower > query.y_upper || limit == 0)
+        return;
+
+    std::size_t remaining = limit;
+
+    uint64_t col_lower = cell_of(std::max(query.x_lower, mMinX), mMinX, mCellWidthX);
+    uint64_t col_upper = cell_of(std::min(query.x_upper, mMaxX), mMinX, mCellWidthX);
+    uint64_t row_lower = cell_of(std::max(query.y_lower, mMinY), mMinY, mCellWidthY);
+    uint64_t row_upper = cell_of(std::min(query.y_upper, mMaxY), mMinY, mCellWidthY);
+
+    for (uint64_t row = row_lower; row <= row_upper; ++row) {
+        uint64_t cell_y_lower = mMinY + row * mCellWidthY, cell_y_upper = cell_y_lower + mCellWidthY - 1;
+        bool row_covered = query.y_lower <= cell_y_lower && cell_y_upper <= query.y_upper;
+
+        for (uint64_t col = col_lower; col <= col_upper; ++col) {
+            uint64_t cell_x_lower = mMinX + col * mCellWidthX, cell_x_upper = cell_x_lower + mCellWidthX - 1;
+            bool covered = row_covered && query.x_lower <= cell_x_lower && cell_x_upper <= query.x_upper;
+
+            auto begin = mPoints.begin() + static_cast<long>(mCellStart[row * mCellsPerSide + col]);
+            auto end = mPoints.begin() + static_cast<long>(mCellStart[row * mCellsPerSide + col + 1]);
+
+            if (covered) {
+                auto count = std::min(static_cast<std::size_t>(end - begin), remaining);
+                foundPts.insert(foundPts.end(), begin, begin + static_cast<long>(count));
+                remaining -= count;
+            }
+            else {
+                for (auto iter = begin; iter != end && remaining > 0; ++iter) {
+                    if (in_range(*iter, query)) {
+                        foundPts.emplace_back(*iter);
+                        --remaining;
+                    }
+                }
+            }
+
+            if (remaining == 0)
+                return;
+        }
+    }
+}
+
+uint64_t GridEngine::cell_of(uint32_t value, uint32_t min, uint64_t width) const {
+    return std::min(static_cast<uint64_t>(value - min) / width, mCellsPerSide - 1);
+}
+
+} // namespace ::Xiuge::RangeTree
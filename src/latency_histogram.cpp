@@ -0,0 +1,85 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "latency_histogram.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+const uint64_t SUB_BUCKETS = uint64_t{1} << LatencyHistogram::SUB_BUCKET_BITS;
+
+// the exact range, then 2^SUB_BUCKET_BITS buckets for each larger power of two
+const std::size_t NUM_BUCKETS = (64 - LatencyHistogram::SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+}
+
+LatencyHistogram::LatencyHistogram() : mCounts(NUM_BUCKETS, 0) {}
+
+std::size_t LatencyHistogram::bucket_of(uint64_t value) {
+    if (value < 2 * SUB_BUCKETS)
+        return static_cast<std::size_t>(value);
+
+    // keep the SUB_BUCKET_BITS bits below the most significant one
+    auto shift = static_cast<unsigned int>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+    return static_cast<std::size_t>(shift * SUB_BUCKETS + (value >> shift));
+}
+
+uint64_t LatencyHistogram::highest_of(std::size_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS)
+        return bucket;
+
+    uint64_t shift = bucket / SUB_BUCKETS - 1, top = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    ++mCounts[bucket_of(value)];
+    ++mCount;
+    mMax = std::max(mMax, value);
+    mSum += static_cast<double>(value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t b = 0; b < mCounts.size(); ++b)
+        mCounts[b] += other.mCounts[b];
+
+    mCount += other.mCount;
+    mMax = std::max(mMax, other.mMax);
+    mSum += other.mSum;
+}
+
+void LatencyHistogram::clear() {
+    std::fill(mCounts.begin(), mCounts.end(), 0);
+    mCount = mMax = 0;
+    mSum = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (mCount == 0)
+        return 0;
+
+    // rank of the value at the percentile, at least the first one
+    double clamped = std::clamp(percentile, 0.0, 100.0);
+    auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100 * static_cast<double>(mCount))));
+    uint64_t seen = 0;
+
+    for (std::size_t b = 0; b < mCounts.size(); ++b) {
+        seen += mCounts[b];
+        if (seen >= rank)
+            return std::min(highest_of(b), mMax);
+    }
+
+    return mMax;
+}
+
+double LatencyHistogram::mean() const {
+    return mCount == 0 ? 0 : mSum / static_cast<double>(mCount);
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -9,6 +9,7 @@ int main() {
     spdlog::info("Start range tree tester");
 
     ExperimentApp experiment;
+    experiment.describe_platform(0);
     auto data_len_base = static_cast<const uint32_t>(2 * pow(10, 3));
 
     // test with construction time, vary data length
@@ -30,5 +31,119 @@ int main() {
 
     experiment.query_time_query_range(queryRanges);
     */
+    /*/ test with query time of the adaptive planner, vary query range
+    std::vector<double> plannerRanges{0.0001, 0.001, 0.01, 0.05, 0.2, 0.5};
+
+    experiment.query_time_planner(plannerRanges);
+    */
+    /*/ test with time to first result of the streaming asynchronous query, vary query range
+    std::vector<double> asyncRanges{0.01, 0.05, 0.2};
+
+    experiment.query_time_async(asyncRanges);
+    */
+    /*/ test with traversal counters of each query, vary query range
+    std::vector<double> statsRanges{0.01, 0.02, 0.05, 0.1, 0.2};
+
+    experiment.query_stats_query_range(statsRanges);
+    */
+    /*/ test with ingest throughput of CSV and binary point files, vary data length
+    std::vector<uint32_t> loadDataLens{64 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.load_time_data_length(loadDataLens);
+    */
+    /*/ test with construction time of std::sort and radix sort pre-sorts, vary data length
+    std::vector<uint32_t> sortDataLens{64 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.construct_time_sort_backend(sortDataLens);
+    */
+    /*/ test with time to first query of eager and lazy construction, vary data length
+    std::vector<uint32_t> lazyDataLens{64 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.construct_time_lazy(lazyDataLens);
+    */
+    /*/ test with query time of interleaved batch queries, vary data length and number of queries in flight
+    std::vector<uint32_t> batchDataLens{512 * data_len_base, 1024 * data_len_base, 2048 * data_len_base};
+    std::vector<std::size_t> groupSizes{1, 4, 8, 16, 32};
+
+    experiment.query_time_batch(batchDataLens, groupSizes);
+    */
+    /*/ test with query time of the original range tree with secondary trees or arrays, vary query range
+    std::vector<double> layoutRanges{0.01, 0.02, 0.05, 0.1, 0.2};
+
+    experiment.query_time_secondary_layout(layoutRanges);
+    */
+    /*/ test with query time of weighted aggregates against reporting and folding the points, vary query range
+    std::vector<double> aggregateRanges{0.01, 0.02, 0.05, 0.1, 0.2};
+
+    experiment.query_time_aggregate(aggregateRanges);
+    */
+    /*/ test with time to count a whole batch of queries offline, vary number of queries
+    std::vector<uint32_t> batchQueryCounts{50 * data_len_base, 500 * data_len_base, 2000 * data_len_base};
+
+    experiment.query_time_batch_count(batchQueryCounts);
+    */
+    /*/ test with tail latency of queries while the tree is being rebuilt, vary data length
+    std::vector<uint32_t> rebuildDataLens{64 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.query_latency_rebuild(rebuildDataLens);
+    */
+    /*/ test with construction time, memory and query time of 32, 40 and 64 bits indices, vary data length
+    std::vector<uint32_t> indexDataLens{64 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.construct_time_index_width(indexDataLens);
+    */
+    /*/ test with query time of the scalar, AVX2 and AVX-512 scan kernels, vary data length
+    std::vector<uint32_t> scanDataLens{data_len_base, 16 * data_len_base, 256 * data_len_base, 512 * data_len_base};
+
+    experiment.query_time_scan_kernel(scanDataLens);
+    */
+    /*/ test with construction and query time of both trees, vary leaf bucket size
+    std::vector<std::size_t> leafSizes{1, 4, 8, 16, 32, 64, 128};
+
+    experiment.query_time_leaf_size(leafSizes);
+    */
+    /*/ test with query time of heavy queries on both trees, vary number of threads per query
+    std::vector<std::size_t> queryThreadCounts{1, 2, 4, 8};
+
+    experiment.query_time_query_threads(queryThreadCounts);
+    */
+    /*/ trace construction and a query batch of both trees, open the file in chrome://tracing or Perfetto
+    experiment.trace_construct_and_batch(512 * data_len_base, "rangetree_trace.json");
+    */
+    /*/ test with query time in warm, cold and rotating cache states, vary query range
+    std::vector<double> cacheRanges{0.001, 0.01, 0.05};
+
+    experiment.query_time_cache_mode(cacheRanges, 4);
+    */
+    /*/ test with query time and error of approximate counting against exact counting, vary query range
+    std::vector<double> approxRanges{0.001, 0.01, 0.05, 0.2};
+
+    experiment.query_time_approx_count(approxRanges, 0.05, 64 << 20);
+    */
+    /*/ test with construction time, memory and query time of collapsing duplicate x-coordinates, vary universe size
+    std::vector<uint32_t> universeSizes{data_len_base, 10 * data_len_base, 100 * data_len_base, 1000 * data_len_base};
+
+    experiment.construct_time_collapse(universeSizes);
+    */
+    /*/ test with open-loop tail latency and the highest rate meeting a p99 target of 1ms, vary arrival rate
+    std::vector<double> qpsRates{1000, 10000, 50000, 100000, 200000};
+
+    experiment.query_latency_open_loop(qpsRates, 1000, "rangetree_queries.trace");
+    */
+    /*/ test with id clustering, compressibility and id lookup time of renumbering along curves, vary query range
+    std::vector<double> localityRanges{0.01, 0.05, 0.2};
+
+    experiment.query_locality_curve(localityRanges);
+    */
+    /*/ test with query time of delta queries against full queries on a panned viewport, vary pan step
+    std::vector<double> panSteps{0.0001, 0.001, 0.005, 0.02};
+
+    experiment.query_time_delta(panSteps);
+    */
+    /*/ test with batch query time of deduplicating and reordering along the Hilbert curve, vary number of queries
+    std::vector<uint32_t> orderCounts{1000, 10000, 100000};
+
+    experiment.query_time_batch_order(orderCounts);
+    */
     return 0;
 }
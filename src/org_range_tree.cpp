@@ -2,62 +2,111 @@
 // Created by Xiuge Chen on 5/22/20.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <queue>
+#include <type_traits>
 #include <vector>
 #include <spdlog/spdlog.h>
 
 #include "org_range_tree.h"
+#include "thread_pool.h"
+#include "tracer.h"
 #include "utils.h"
 
 namespace Xiuge::RangeTree {
 
 namespace {
 
+// do not bother splitting the copy of the answers of the canonical subtrees for small answers
+const std::size_t MIN_POINTS_PER_COPY_THREAD = 1 << 14;
+
 inline bool in_range(Point pt, Query query) {
     return query.x_lower <= pt.x && pt.x <= query.x_upper
            && query.y_lower <= pt.y && pt.y <= query.y_upper;
 }
 
+// append the other points of a leaf bucket that pass the check, stop once points grows to maxSize
+template <typename Check>
+void scan_bucket(const std::vector<Point>& buckets, const OrgRangeTreePrimaryNode* node, std::vector<Point>& points,
+                 std::size_t maxSize, Check&& check) {
+    for (std::size_t i = node->bucketBegin; i < node->bucketBegin + node->bucketSize; ++i) {
+        if (points.size() >= maxSize)
+            return;
+
+        if (check(buckets[i]))
+            points.emplace_back(buckets[i]);
+    }
+}
+
+}
+
+OrgRangeTree::~OrgRangeTree() {
+    stop_warm_up();
 }
 
 void OrgRangeTree::construct_tree(std::vector<Point>& points, bool isNaive) {
+    TraceScope trace("OrgRangeTree::construct_tree");
     spdlog::info("[OrgRangeTree] Start original range tree construction");
 
-    // in-place sort ascendingly by x, and then by y, break tie by id
-    sort(points.begin(), points.end());
+    stop_warm_up();
+
+    // in-place sort ascendingly by x, and then by y, break tie by id, the buffer is reused by the second sort
+    std::vector<Point> sortBuffer;
+    sort_by_x(points, mSortBackend, sortBuffer);
 
     // build on first dimension
-    mRoot = build_tree(points, 0, static_cast<int>(points.size() - 1), 1);
+    {
+        TraceScope buildTrace("OrgRangeTree::build_tree");
+        mBuckets.clear();
+        mRoot = build_tree<OrgRangeTreePrimaryNode>(points, 0, points.size(), mLeafSize, &mBuckets);
+    }
 
     // Uncomment if debug
     // spdlog::debug("[OrgRangeTree] Constructed tree in first dimension");
     // print_tree(mRoot.get(), 0);
 
-    // build on second dimension, either naively using O(n log^2 n) time, or smartly use O(n log n) time.
-    if (isNaive) {
+    // build on second dimension, either naively using O(n log^2 n) time, or smartly use O(n log n) time, or leave it
+    // to ensure_sec_dim_tree in lazy mode.
+    if (mLazy) {
+        spdlog::info("[OrgRangeTree] Defer secondary tree construction to first access");
+    }
+    else if (isNaive) {
         spdlog::info("[OrgRangeTree] Start naive secondary tree construction");
-        build_sec_dim_naive(mRoot.get());
+
+        TraceScope secTrace("OrgRangeTree::build_sec_dim_naive");
+        build_sec_dim_naive(mRoot.get(), mSecondaryLayout);
     }
     else {
         // in-place sort ascendingly by y, break tie by id
-        sort(points.begin(), points.end(),
-             [](const Point& a, const Point& b) -> bool
-             {
-                 return a.y == b.y ? a.id < b.id : a.y < b.y;
-             });
+        sort_by_y(points, mSortBackend, sortBuffer);
 
         spdlog::info("[OrgRangeTree] Start smart secondary tree construction");
-        build_sec_dim_smart(points, mRoot.get());
+
+        TraceScope secTrace("OrgRangeTree::build_sec_dim_smart");
+        build_sec_dim_smart(points, mRoot.get(), mSecondaryLayout);
     }
 }
 
-void OrgRangeTree::build_sec_dim_naive(OrgRangeTreeNode* node) {
+void OrgRangeTree::build_sec_dim_naive(OrgRangeTreePrimaryNode* node, SecondaryLayout layout) {
     if (node == nullptr)
         return;
 
-    if (unlikely(node->nextDimRoot))
+    build_sec_dim_node(node, layout);
+
+    // recursively build for all children
+    build_sec_dim_naive(node->left.get(), layout);
+    build_sec_dim_naive(node->right.get(), layout);
+}
+
+void OrgRangeTree::build_sec_dim_node(OrgRangeTreePrimaryNode* node, SecondaryLayout layout) {
+    if (unlikely(node->nextDimRoot || !node->nextDimArray.empty()))
         throw std::runtime_error("[DataGenerator] tree of next dimension already being created");
 
+    // a leaf bucket is scanned instead
+    if (node->bucketSize > 0)
+        return;
+
     std::vector<Point> points;
     in_order_traverse(node, points);
 
@@ -68,26 +117,74 @@ void OrgRangeTree::build_sec_dim_naive(OrgRangeTreeNode* node) {
              return a.y == b.y ? a.id < b.id : a.y < b.y;
          });
 
-    node->nextDimRoot = build_tree(points, 0, static_cast<int>(points.size() - 1), 2);
+    if (layout == SecondaryLayout::Array) {
+        node->nextDimArray = std::move(points);
+        return;
+    }
+
+    node->nextDimRoot = build_tree<OrgRangeTreeNode>(points, 0, points.size());
 
     // Uncomment if debug
     // spdlog::debug("[OrgRangeTree] Constructed secondary tree rooted at node x={}, y={}, id={}", node->point.x, node->point.y, node->point.id);
     // print_tree(node->nextDimRoot.get(), 0);
+}
 
-    // recursively build for all children
-    build_sec_dim_naive(node->left.get());
-    build_sec_dim_naive(node->right.get());
+void OrgRangeTree::ensure_sec_dim_tree(OrgRangeTreePrimaryNode* node) {
+    if (mLazy)
+        std::call_once(node->nextDimOnce, [this, node] { build_sec_dim_node(node, mSecondaryLayout); });
+}
+
+void OrgRangeTree::warm_up_async() {
+    if (!mLazy || !mRoot)
+        return;
+
+    stop_warm_up();
+    mStopWarming = false;
+
+    mWarmer = std::thread([this] {
+        std::queue<OrgRangeTreePrimaryNode*> nodes;
+        nodes.push(mRoot.get());
+
+        // breadth first, so that nodes near the root, which are shared by most queries, are built first
+        while (!nodes.empty() && !mStopWarming) {
+            OrgRangeTreePrimaryNode* node = nodes.front();
+            nodes.pop();
+
+            ensure_sec_dim_tree(node);
+
+            if (node->left)
+                nodes.push(node->left.get());
+
+            if (node->right)
+                nodes.push(node->right.get());
+        }
+    });
+}
+
+void OrgRangeTree::stop_warm_up() {
+    mStopWarming = true;
+
+    if (mWarmer.joinable())
+        mWarmer.join();
 }
 
-void OrgRangeTree::build_sec_dim_smart(std::vector<Point>& points, OrgRangeTreeNode* node) {
+void OrgRangeTree::build_sec_dim_smart(std::vector<Point>& points, OrgRangeTreePrimaryNode* node,
+                                       SecondaryLayout layout) {
     if (node == nullptr)
         return;
 
-    if (unlikely(node->nextDimRoot))
+    if (unlikely(node->nextDimRoot || !node->nextDimArray.empty()))
         throw std::runtime_error("[DataGenerator] tree of next dimension already being created");
 
-    // create secondary tree
-    node->nextDimRoot = build_tree(points, 0, static_cast<int>(points.size() - 1), 2);
+    // a leaf bucket is scanned instead, and has no children
+    if (node->bucketSize > 0)
+        return;
+
+    // create secondary tree, or keep a copy of the points which are already sorted by y
+    if (layout == SecondaryLayout::Array)
+        node->nextDimArray = points;
+    else
+        node->nextDimRoot = build_tree<OrgRangeTreeNode>(points, 0, points.size());
 
     // Uncomment if debug
     // spdlog::debug("[OrgRangeTree] Constructed secondary tree rooted at node x={}, y={}, id={}", node->point.x, node->point.y, node->point.id);
@@ -107,22 +204,38 @@ void OrgRangeTree::build_sec_dim_smart(std::vector<Point>& points, OrgRangeTreeN
             rightPts.emplace_back(point);
     }
 
-    build_sec_dim_smart(leftPts, node->left.get());
-    build_sec_dim_smart(rightPts, node->right.get());
+    build_sec_dim_smart(leftPts, node->left.get(), layout);
+    build_sec_dim_smart(rightPts, node->right.get(), layout);
 }
 
-std::unique_ptr<OrgRangeTreeNode> OrgRangeTree::build_tree(std::vector<Point>& points, const int start,
-                                                         const int end, const int dim) {
-    if (start > end)
+template <typename Node>
+std::unique_ptr<Node> OrgRangeTree::build_tree(std::vector<Point>& points, std::size_t begin, std::size_t end,
+                                               std::size_t leafSize, std::vector<Point>* buckets) {
+    if (begin >= end)
         return nullptr;
 
-    int mid = start + (end - start) / 2; // integer division
+    // stop at a leaf bucket, which keeps its smallest point as the node and the others contiguously in buckets
+    if (end - begin <= leafSize) {
+        std::unique_ptr<Node> node(new Node(points[begin]));
+
+        if constexpr (std::is_same_v<Node, OrgRangeTreePrimaryNode>) {
+            node->maxX = points[end - 1].x;
+            node->bucketSize = static_cast<uint32_t>(end - begin - 1);
+            node->bucketBegin = buckets->size();
+            buckets->insert(buckets->end(), points.begin() + static_cast<std::ptrdiff_t>(begin + 1),
+                            points.begin() + static_cast<std::ptrdiff_t>(end));
+        }
+
+        return node;
+    }
+
+    std::size_t mid = begin + (end - begin - 1) / 2; // lower middle
 
-    std::unique_ptr<OrgRangeTreeNode> node(new OrgRangeTreeNode(points[static_cast<unsigned long>(mid)], dim));
+    std::unique_ptr<Node> node(new Node(points[mid]));
 
     // construct tree in only first dimension
-    node->left = build_tree(points, start, mid - 1, dim);
-    node->right = build_tree(points, mid + 1, end, dim);
+    node->left = build_tree<Node>(points, begin, mid, leafSize, buckets);
+    node->right = build_tree<Node>(points, mid + 1, end, leafSize, buckets);
 
     // assign parent to each children
     if (node->left)
@@ -134,198 +247,296 @@ std::unique_ptr<OrgRangeTreeNode> OrgRangeTree::build_tree(std::vector<Point>& p
     return node;
 }
 
-void OrgRangeTree::report_points(Query query, std::vector<Point>& foundPts) {
-    query_tree(mRoot.get(), foundPts, query, true);
+void OrgRangeTree::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    if (mQueryThreads > 1 && limit == NO_LIMIT) {
+        report_points_parallel(query, foundPts);
+        return;
+    }
+
+    std::size_t maxSize = limit > NO_LIMIT - foundPts.size() ? NO_LIMIT : foundPts.size() + limit;
+    query_tree<FirstDim, false>(mRoot.get(), foundPts, query, maxSize, nullptr);
 }
 
-void OrgRangeTree::query_tree(OrgRangeTreeNode* node, std::vector<Point>& points, Query query, bool fstDim) {
-    if (node == nullptr)
+void OrgRangeTree::report_points(Query query, std::vector<Point>& foundPts, QueryStats& stats, std::size_t limit) {
+    std::size_t maxSize = limit > NO_LIMIT - foundPts.size() ? NO_LIMIT : foundPts.size() + limit;
+    query_tree<FirstDim, true>(mRoot.get(), foundPts, query, maxSize, &stats);
+}
+
+void OrgRangeTree::report_points_parallel(Query query, std::vector<Point>& foundPts) {
+    // the points on the search paths go straight to foundPts, the canonical subtrees are searched afterwards
+    std::vector<OrgRangeTreePrimaryNode*> canonical;
+    query_tree<FirstDim, false>(mRoot.get(), foundPts, query, NO_LIMIT, nullptr, &canonical);
+
+    std::size_t numSlices = std::min(mQueryThreads, canonical.size());
+
+    if (numSlices <= 1) {
+        for (auto node : canonical)
+            query_sec_dim<false>(node, foundPts, query, NO_LIMIT, nullptr);
+
         return;
+    }
+
+    // each thread takes the next canonical subtree, so a few large subtrees do not hold up the others
+    std::vector<std::vector<Point>> parts(canonical.size());
+    std::atomic<std::size_t> next{0};
+
+    ThreadPool::shared().parallel_for(numSlices, [&](std::size_t ) {
+        TraceScope trace("OrgRangeTree::query_sec_dim slice");
+
+        for (std::size_t i = next++; i < canonical.size(); i = next++)
+            query_sec_dim<false>(canonical[i], parts[i], query, NO_LIMIT, nullptr);
+    });
+
+    // output offset of each part, then copy the parts in the same way
+    std::vector<std::size_t> offsets{foundPts.size()};
+    for (auto& part : parts)
+        offsets.push_back(offsets.back() + part.size());
+
+    if (offsets.back() - offsets.front() < 2 * MIN_POINTS_PER_COPY_THREAD) {
+        for (auto& part : parts)
+            foundPts.insert(foundPts.end(), part.begin(), part.end());
+
+        return;
+    }
+
+    foundPts.resize(offsets.back());
+    next = 0;
+
+    ThreadPool::shared().parallel_for(numSlices, [&](std::size_t ) {
+        TraceScope trace("OrgRangeTree::copy_parts slice");
+
+        for (std::size_t i = next++; i < parts.size(); i = next++)
+            std::copy(parts[i].begin(), parts[i].end(), foundPts.begin() + static_cast<std::ptrdiff_t>(offsets[i]));
+    });
+}
+
+template <typename Dim, bool CollectStats>
+void OrgRangeTree::query_tree(typename Dim::Node* node, std::vector<Point>& points, Query query, std::size_t maxSize,
+                              QueryStats* stats, std::vector<OrgRangeTreePrimaryNode*>* canonical) {
+    if (node == nullptr || points.size() >= maxSize)
+        return;
+
+    if constexpr (CollectStats && !Dim::IS_PRIMARY)
+        ++stats->secondarySearches;
 
     // find the successor of x_min/y_min and the predecessor of x_max/y_max
-    OrgRangeTreeNode* succ_min = tree_search(node, fstDim ? query.x_lower : query.y_lower, true, fstDim);
-    OrgRangeTreeNode* pred_max = tree_search(node, fstDim ? query.x_upper : query.y_upper, false, fstDim);
-    OrgRangeTreeNode* tree_iter = nullptr;
+    auto succ_min = tree_search<Dim, CollectStats>(node, Dim::lower(query), true, stats);
+    auto pred_max = tree_search<Dim, CollectStats>(node, Dim::upper(query), false, stats);
 
-    // none of points are in range
-    if (succ_min == nullptr || pred_max == nullptr || (fstDim && succ_min->point.x > pred_max->point.x)
-        || (!fstDim && succ_min->point.y > pred_max->point.y))
+    // none of points are in range, in the first dimension succ_min and pred_max may be the same leaf bucket
+    if (succ_min == nullptr || pred_max == nullptr || Dim::less(pred_max->point, succ_min->point))
         return;
 
-    // find the lowest common ancestor of succ_x_min and pred_x_max
-    OrgRangeTreeNode* lca = find_lca(node, succ_min, pred_max, fstDim);
+    auto in_query = [&query](const Point& point) -> bool { return in_range(point, query); };
+
+    // find the lowest common ancestor of succ_min and pred_max
+    auto lca = find_lca<Dim, CollectStats>(node, succ_min, pred_max, stats);
 
     // return lca if it is in range
     if (in_range(lca->point, query))
         points.emplace_back(lca->point);
+    else if constexpr (CollectStats)
+        ++stats->rangeRejections;
+
+    if constexpr (Dim::IS_PRIMARY)
+        scan_bucket(mBuckets, lca, points, maxSize, in_query);
+
+    if (points.size() >= maxSize)
+        return;
 
     // For each node u other than lca on the path from lca to succ_min, add it if it is in range.
-    // If first dimention and succ_min.x <= u.x, then report all the points in u’s right sub-tree whose y-coordinates
-    // are in [y_lower, y_upper] in the secondary tree;
-    // If second dimention and succ_min.y <= u.y, then report all the points in u’s right sub-tree;
-    if (lca->point.id != succ_min->point.id) {
-        tree_iter = lca->left.get();
+    // If succ_min is not after u, then all the points in u’s right sub-tree are in range of this dimension, report the
+    // ones whose y-coordinates are in [y_lower, y_upper] from the secondary tree in the first dimension, or all of
+    // them in the second dimension
+    if (lca != succ_min) {
+        auto tree_iter = lca->left.get();
 
-        while(true) {
+        while (points.size() < maxSize) {
             if (in_range(tree_iter->point, query))
                 points.emplace_back(tree_iter->point);
+            else if constexpr (CollectStats)
+                ++stats->rangeRejections;
 
-            if (fstDim) {
-                if (succ_min->point.x <= tree_iter->point.x && tree_iter->right)
-                    query_tree(tree_iter->right->nextDimRoot.get(), points, query, false);
+            if constexpr (Dim::IS_PRIMARY) {
+                if constexpr (CollectStats)
+                    ++stats->primaryNodes;
 
-                if (succ_min->point == tree_iter->point)
-                    break;
-                else if (succ_min->point < tree_iter->point)
-                    tree_iter = tree_iter->left.get();
-                else
-                    tree_iter = tree_iter->right.get();
-            }
-            else {
-                if (succ_min->point.y <= tree_iter->point.y)
-                    in_order_traverse(tree_iter->right.get(), points);
-
-                if (succ_min->point.id == tree_iter->point.id)
-                    break;
-                else if (succ_min->point.y < tree_iter->point.y)
-                    tree_iter = tree_iter->left.get();
-                else if (succ_min->point.y > tree_iter->point.y)
-                    tree_iter = tree_iter->right.get();
-                else
-                    tree_iter = succ_min->point.id < tree_iter->point.id ? tree_iter->left.get() : tree_iter->right.get();
+                scan_bucket(mBuckets, tree_iter, points, maxSize, in_query);
             }
+
+            if (!Dim::less(tree_iter->point, succ_min->point) && tree_iter->right)
+                report_canonical<Dim, CollectStats>(tree_iter->right.get(), points, query, maxSize, stats, canonical);
+
+            if (tree_iter == succ_min)
+                break;
+
+            tree_iter = Dim::less(succ_min->point, tree_iter->point) ? tree_iter->left.get() : tree_iter->right.get();
         }
     }
 
     // for each node u other than lca on the path from lca to pred_max, add it if it is in range
-    // If first dimention and pred_max.x >= u.x, then report all the points in u’s left sub-tree whose y-coordinates
-    // are in [y_lower, y_upper] in the secondary tree;
-    // If second dimention and pred_max.y >= u.y, then report all the points in u’s left sub-tree;
-    if (lca->point.id != pred_max->point.id) {
-        tree_iter = lca->right.get();
+    // If pred_max is not before u, then report the points in u’s left sub-tree in the same way
+    if (lca != pred_max) {
+        auto tree_iter = lca->right.get();
 
-        while (true) {
+        while (points.size() < maxSize) {
             if (in_range(tree_iter->point, query))
                 points.emplace_back(tree_iter->point);
+            else if constexpr (CollectStats)
+                ++stats->rangeRejections;
 
-            if (fstDim) {
-                if (pred_max->point.x >= tree_iter->point.x && tree_iter->left)
-                    query_tree(tree_iter->left->nextDimRoot.get(), points, query, false);
+            if constexpr (Dim::IS_PRIMARY) {
+                if constexpr (CollectStats)
+                    ++stats->primaryNodes;
 
-                if (pred_max->point == tree_iter->point)
-                    break;
-                else if (pred_max->point < tree_iter->point)
-                    tree_iter = tree_iter->left.get();
-                else
-                    tree_iter = tree_iter->right.get();
-            }
-            else {
-                if (pred_max->point.y >= tree_iter->point.y)
-                    in_order_traverse(tree_iter->left.get(), points);
-
-                if (pred_max->point.id == tree_iter->point.id)
-                    break;
-                else if (pred_max->point.y < tree_iter->point.y)
-                    tree_iter = tree_iter->left.get();
-                else if (pred_max->point.y > tree_iter->point.y)
-                    tree_iter = tree_iter->right.get();
-                else
-                    tree_iter = pred_max->point.id < tree_iter->point.id ? tree_iter->left.get() : tree_iter->right.get();
+                scan_bucket(mBuckets, tree_iter, points, maxSize, in_query);
             }
+
+            if (!Dim::less(pred_max->point, tree_iter->point) && tree_iter->left)
+                report_canonical<Dim, CollectStats>(tree_iter->left.get(), points, query, maxSize, stats, canonical);
+
+            if (tree_iter == pred_max)
+                break;
+
+            tree_iter = Dim::less(pred_max->point, tree_iter->point) ? tree_iter->left.get() : tree_iter->right.get();
         }
     }
 }
 
-OrgRangeTreeNode* OrgRangeTree::tree_search(OrgRangeTreeNode* node, uint32_t value, bool findSucc, bool fstDim) {
-    OrgRangeTreeNode* result = nullptr;
+template <typename Dim, bool CollectStats>
+void OrgRangeTree::report_canonical(typename Dim::Node* node, std::vector<Point>& points, Query query,
+                                    std::size_t maxSize, QueryStats* stats,
+                                    std::vector<OrgRangeTreePrimaryNode*>* canonical) {
+    if constexpr (Dim::IS_PRIMARY) {
+        if (canonical)
+            canonical->push_back(node);
+        else
+            query_sec_dim<CollectStats>(node, points, query, maxSize, stats);
+    }
+    else {
+        in_order_traverse(node, points, maxSize);
+
+        if constexpr (CollectStats)
+            ++stats->canonicalSubtrees;
+    }
+}
+
+template <bool CollectStats>
+void OrgRangeTree::query_sec_dim(OrgRangeTreePrimaryNode* node, std::vector<Point>& points, Query query,
+                                 std::size_t maxSize, QueryStats* stats) {
+    // all points of a leaf bucket are in the x range, check their y-coordinates
+    if (node->bucketSize > 0) {
+        auto in_y_range = [&query](const Point& point) -> bool {
+            return query.y_lower <= point.y && point.y <= query.y_upper;
+        };
+
+        if (points.size() < maxSize && in_y_range(node->point))
+            points.emplace_back(node->point);
+
+        scan_bucket(mBuckets, node, points, maxSize, in_y_range);
+
+        if constexpr (CollectStats)
+            ++stats->canonicalSubtrees;
+
+        return;
+    }
+
+    ensure_sec_dim_tree(node);
+
+    if (node->nextDimRoot || node->nextDimArray.empty()) {
+        query_tree<SecondDim, CollectStats>(node->nextDimRoot.get(), points, query, maxSize, stats);
+        return;
+    }
+
+    // all points of the subtree are in the x range, the ones in the y range are a contiguous slice of the array
+    auto& nextDimArray = node->nextDimArray;
+    auto begin = std::lower_bound(nextDimArray.begin(), nextDimArray.end(), query.y_lower,
+                                  [](const Point& point, uint32_t y) -> bool { return point.y < y; });
+    auto end = std::upper_bound(begin, nextDimArray.end(), query.y_upper,
+                                [](uint32_t y, const Point& point) -> bool { return y < point.y; });
+
+    if constexpr (CollectStats) {
+        ++stats->secondarySearches;
+
+        if (begin != end)
+            ++stats->canonicalSubtrees;
+    }
+
+    auto count = std::min(static_cast<std::size_t>(end - begin), maxSize - points.size());
+    points.insert(points.end(), begin, begin + static_cast<std::ptrdiff_t>(count));
+}
+
+template <typename Dim, bool CollectStats>
+typename Dim::Node* OrgRangeTree::tree_search(typename Dim::Node* node, uint32_t value, bool findSucc,
+                                              QueryStats* stats) {
+    typename Dim::Node* result = nullptr;
 
     if (findSucc) {
         while (node != nullptr) {
-            if (fstDim) {
-                if (node->point.x >= value) {
-                    result = node;
-                    node = node->left.get();
-                }
-                else
-                    node = node->right.get();
-            }
-            else {
-                if (node->point.y >= value) {
-                    result = node;
-                    node = node->left.get();
-                }
-                else
-                    node = node->right.get();
-            }
+            if constexpr (CollectStats && Dim::IS_PRIMARY)
+                ++stats->primaryNodes;
+
+            // a leaf bucket holds the successor if any of its points does
+            bool isCandidate = Dim::max_coord(node) >= value;
+            result = isCandidate ? node : result;
+            node = isCandidate ? node->left.get() : node->right.get();
         }
     }
     else {
         while (node != nullptr) {
-            if (fstDim) {
-                if (node->point.x <= value) {
-                    result = node;
-                    node = node->right.get();
-                }
-                else
-                    node = node->left.get();
-            }
-            else {
-                if (node->point.y <= value) {
-                    result = node;
-                    node = node->right.get();
-                }
-                else
-                    node = node->left.get();
-            }
+            if constexpr (CollectStats && Dim::IS_PRIMARY)
+                ++stats->primaryNodes;
+
+            bool isCandidate = Dim::coord(node->point) <= value;
+            result = isCandidate ? node : result;
+            node = isCandidate ? node->right.get() : node->left.get();
         }
     }
 
     return result;
 }
 
-OrgRangeTreeNode* OrgRangeTree::find_lca(OrgRangeTreeNode* node, OrgRangeTreeNode* succ, OrgRangeTreeNode* pred, bool fstDim) {
-    OrgRangeTreeNode* tree_iter = node;
+template <typename Dim, bool CollectStats>
+typename Dim::Node* OrgRangeTree::find_lca(typename Dim::Node* node, typename Dim::Node* succ,
+                                           typename Dim::Node* pred, QueryStats* stats) {
+    typename Dim::Node* tree_iter = node;
 
     while (tree_iter != nullptr) {
-        if (tree_iter->point == succ->point || tree_iter->point == pred->point)
+        if constexpr (CollectStats && Dim::IS_PRIMARY)
+            ++stats->primaryNodes;
+
+        if (tree_iter == succ || tree_iter == pred)
             return tree_iter;
 
-        if (fstDim) {
-            if (tree_iter->point.x >= succ->point.x) {
-                if (tree_iter->point.x <= pred->point.x)
-                    return tree_iter;
-                else
-                    tree_iter = tree_iter->left.get();
-            }
-            else {
-                tree_iter = tree_iter->right.get();
-            }
-        }
-        else {
-            if (tree_iter->point.y >= succ->point.y) {
-                if (tree_iter->point.y <= pred->point.y)
-                    return tree_iter;
-                else
-                    tree_iter = tree_iter->left.get();
-            }
-            else {
-                tree_iter = tree_iter->right.get();
-            }
-        }
+        // compare in the order of the tree, a leaf bucket spans many coordinates
+        if (Dim::less(pred->point, tree_iter->point))
+            tree_iter = tree_iter->left.get();
+        else if (Dim::less(tree_iter->point, succ->point))
+            tree_iter = tree_iter->right.get();
+        else
+            return tree_iter;
     }
 
     return nullptr;
 }
 
-void OrgRangeTree::in_order_traverse(OrgRangeTreeNode* node, std::vector<Point>& points) {
-    if (node) {
-        in_order_traverse(node->left.get(), points);
-        points.emplace_back(node->point);
-        in_order_traverse(node->right.get(), points);
+template <typename Node>
+void OrgRangeTree::in_order_traverse(Node* node, std::vector<Point>& points, std::size_t maxSize) const {
+    if (node && points.size() < maxSize) {
+        in_order_traverse(node->left.get(), points, maxSize);
+
+        if (points.size() < maxSize)
+            points.emplace_back(node->point);
+
+        if constexpr (std::is_same_v<Node, OrgRangeTreePrimaryNode>)
+            scan_bucket(mBuckets, node, points, maxSize, [](const Point& ) -> bool { return true; });
+
+        in_order_traverse(node->right.get(), points, maxSize);
     }
 }
 
-void OrgRangeTree::print_tree(OrgRangeTreeNode* node, const int level) {
+template <typename Node>
+void OrgRangeTree::print_tree(Node* node, const int level) {
     if (node) {
         print_tree(node->right.get(), level + 1);
 
@@ -0,0 +1,195 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "platform.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+const std::string SYS_CPU_DIR = "/sys/devices/system/cpu/";
+
+// assumed when the size of the last level cache could not be read
+const std::size_t DEFAULT_LLC_SIZE = 64 << 20;
+
+// words touched per cache line by the flusher
+const std::size_t WORDS_PER_LINE = 64 / sizeof(uint64_t);
+
+// first line of a file, empty if it could not be read
+std::string read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+
+    return line;
+}
+
+// parse a sysfs cache size like "32K" or "8M" into bytes
+std::size_t parse_size(const std::string& text) {
+    std::size_t pos = 0, size = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+        size = size * 10 + static_cast<std::size_t>(text[pos++] - '0');
+
+    if (pos < text.size() && text[pos] == 'K')
+        size <<= 10;
+    else if (pos < text.size() && text[pos] == 'M')
+        size <<= 20;
+
+    return size;
+}
+
+}
+
+PlatformInfo platform_info() {
+    PlatformInfo info;
+    info.logicalCpus = std::thread::hardware_concurrency();
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);) {
+        if (line.rfind("model name", 0) == 0) {
+            auto colon = line.find(':');
+            info.cpuModel = colon == std::string::npos ? line : line.substr(std::min(colon + 2, line.size()));
+            break;
+        }
+    }
+
+    // a core is identified by its package and its id within the package
+    std::set<std::pair<std::string, std::string>> cores;
+    std::set<std::string> packages;
+
+    for (std::size_t cpu = 0; cpu < info.logicalCpus; ++cpu) {
+        std::string topology = SYS_CPU_DIR + "cpu" + std::to_string(cpu) + "/topology/";
+        std::string package = read_line(topology + "physical_package_id");
+        std::string core = read_line(topology + "core_id");
+
+        if (package.empty() || core.empty())
+            continue;
+
+        packages.insert(package);
+        cores.emplace(package, core);
+    }
+
+    info.physicalCores = cores.size();
+    info.packages = packages.size();
+
+    // the caches of cpu0, the largest level is the last level cache
+    for (std::size_t index = 0;; ++index) {
+        std::string cache = SYS_CPU_DIR + "cpu0/cache/index" + std::to_string(index) + "/";
+        std::string level = read_line(cache + "level");
+
+        if (level.empty())
+            break;
+
+        std::string type = read_line(cache + "type");
+        std::size_t size = parse_size(read_line(cache + "size"));
+
+        if (level == "1" && type == "Data")
+            info.l1dCacheSize = size;
+        else if (level == "2")
+            info.l2CacheSize = size;
+
+        if (level != "1")
+            info.llcSize = size;
+    }
+
+    return info;
+}
+
+double cpu_frequency_mhz(std::size_t cpu) {
+    std::string khz = read_line(SYS_CPU_DIR + "cpu" + std::to_string(cpu) + "/cpufreq/scaling_cur_freq");
+    if (!khz.empty())
+        return std::stod(khz) / 1000.0;
+
+    // without cpufreq, the n-th "cpu MHz" line of /proc/cpuinfo belongs to the n-th processor
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::size_t seen = 0;
+
+    for (std::string line; std::getline(cpuinfo, line);) {
+        if (line.rfind("cpu MHz", 0) != 0)
+            continue;
+
+        if (seen++ == cpu) {
+            auto colon = line.find(':');
+            return colon == std::string::npos ? 0 : std::stod(line.substr(colon + 1));
+        }
+    }
+
+    return 0;
+}
+
+bool pin_current_thread(std::size_t cpu) {
+#ifdef __linux__
+    if (cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void) cpu;
+    return false;
+#endif
+}
+
+ThreadPin::ThreadPin(std::size_t cpu) {
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        return;
+
+    for (std::size_t c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &cpuSet))
+            mSavedCpus.emplace_back(c);
+    }
+
+    mPinned = pin_current_thread(cpu);
+#else
+    (void) cpu;
+#endif
+}
+
+ThreadPin::~ThreadPin() {
+#ifdef __linux__
+    if (!mPinned)
+        return;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (auto c : mSavedCpus)
+        CPU_SET(c, &cpuSet);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
+
+CacheFlusher::CacheFlusher(std::size_t llcSize, std::size_t factor)
+        : mBuffer((llcSize > 0 ? llcSize : DEFAULT_LLC_SIZE) * std::max<std::size_t>(factor, 1) / sizeof(uint64_t), 1) {}
+
+void CacheFlusher::flush() {
+    // write one word of every line, so that dirty lines of the buffer, not of the caller, fill the caches
+    for (std::size_t i = 0; i < mBuffer.size(); i += WORDS_PER_LINE) {
+        mBuffer[i] += mSink;
+        mSink ^= mBuffer[i];
+    }
+
+    // keep the loop from being optimized away
+    asm volatile("" : : "r"(mSink) : "memory");
+}
+
+} // namespace ::Xiuge::RangeTree
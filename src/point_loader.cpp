@@ -0,0 +1,295 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "point_loader.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+const char BINARY_MAGIC[4] = {'R', 'T', 'P', 'T'};
+const uint32_t BINARY_VERSION = 1;
+const std::size_t BINARY_HEADER_SIZE = 16;
+// id, x and y of a point, each in its own column
+const std::size_t BINARY_RECORD_SIZE = 3 * sizeof(uint32_t);
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (unlikely(fd < 0))
+            throw std::runtime_error("[PointLoader] cannot open file " + path);
+
+        struct stat st{};
+        if (unlikely(fstat(fd, &st) != 0)) {
+            close(fd);
+            throw std::runtime_error("[PointLoader] cannot stat file " + path);
+        }
+
+        mSize = static_cast<std::size_t>(st.st_size);
+
+        if (mSize > 0) {
+            void* addr = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (unlikely(addr == MAP_FAILED))
+                throw std::runtime_error("[PointLoader] cannot mmap file " + path);
+
+            madvise(addr, mSize, MADV_SEQUENTIAL);
+            mData = static_cast<const char*>(addr);
+        }
+        else
+            close(fd);
+    }
+
+    ~MappedFile() {
+        if (mData)
+            munmap(const_cast<char*>(mData), mSize);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return mData; }
+
+    std::size_t size() const { return mSize; }
+
+private:
+    const char* mData = nullptr;
+    std::size_t mSize = 0;
+};
+
+long long int now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now().time_since_epoch()
+    ).count();
+}
+
+uint32_t from_little_endian(uint32_t value) {
+    if constexpr (std::endian::native == std::endian::little)
+        return value;
+    else
+        return __builtin_bswap32(value);
+}
+
+// parse an unsigned integer at iter, skipping leading blanks, advance iter past it
+inline uint32_t parse_uint(const char*& iter, const char* end) {
+    while (iter < end && (*iter == ' ' || *iter == '\t'))
+        ++iter;
+
+    if (unlikely(iter == end || static_cast<unsigned>(*iter - '0') > 9))
+        throw std::runtime_error("[PointLoader] malformed CSV, expect an unsigned integer");
+
+    uint64_t value = 0;
+    while (iter < end && static_cast<unsigned>(*iter - '0') <= 9) {
+        value = value * 10 + static_cast<uint64_t>(*iter - '0');
+        ++iter;
+
+        if (unlikely(value > UINT32_MAX))
+            throw std::runtime_error("[PointLoader] malformed CSV, integer out of range");
+    }
+
+    while (iter < end && (*iter == ' ' || *iter == '\t'))
+        ++iter;
+
+    return static_cast<uint32_t>(value);
+}
+
+// parse all lines in [begin, end), which has to start at a line boundary
+void parse_csv_chunk(const char* begin, const char* end, std::vector<Point>& points) {
+    const char* iter = begin;
+
+    while (iter < end) {
+        // skip empty lines
+        if (*iter == '\n' || *iter == '\r') {
+            ++iter;
+            continue;
+        }
+
+        Point point;
+        point.id = parse_uint(iter, end);
+
+        if (unlikely(iter == end || *iter++ != ','))
+            throw std::runtime_error("[PointLoader] malformed CSV, expect ','");
+        point.x = parse_uint(iter, end);
+
+        if (unlikely(iter == end || *iter++ != ','))
+            throw std::runtime_error("[PointLoader] malformed CSV, expect ','");
+        point.y = parse_uint(iter, end);
+
+        if (unlikely(iter < end && *iter != '\n' && *iter != '\r'))
+            throw std::runtime_error("[PointLoader] malformed CSV, expect end of line");
+
+        points.emplace_back(point);
+    }
+}
+
+}
+
+PointLoader::PointLoader(std::size_t numThreads)
+    : mNumThreads(std::max<std::size_t>(1, numThreads))
+{}
+
+std::vector<Point> PointLoader::load_csv(const std::string& path) {
+    long long int startTime = now_us();
+
+    MappedFile file(path);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // skip the header line if it does not start with a digit
+    if (begin < end && static_cast<unsigned>(*begin - '0') > 9) {
+        begin = static_cast<const char*>(std::memchr(begin, '\n', file.size()));
+        begin = begin ? begin + 1 : end;
+    }
+
+    // split into chunks at line boundaries, roughly of the same size
+    auto numChunks = std::min<std::size_t>(mNumThreads, static_cast<std::size_t>(end - begin) / 4096 + 1);
+    std::vector<const char*> bounds{begin};
+
+    for (std::size_t c = 1; c < numChunks; ++c) {
+        const char* bound = begin + static_cast<long>(static_cast<std::size_t>(end - begin) * c / numChunks);
+        bound = std::max(bound, bounds.back());
+        auto newline = static_cast<const char*>(std::memchr(bound, '\n', static_cast<std::size_t>(end - bound)));
+        bounds.emplace_back(newline ? newline + 1 : end);
+    }
+    bounds.emplace_back(end);
+
+    std::vector<std::vector<Point>> chunks(numChunks);
+    std::vector<std::exception_ptr> errors(numChunks);
+
+    ThreadPool::shared().parallel_for(numChunks, [&](std::size_t c) {
+        try {
+            chunks[c].reserve(static_cast<std::size_t>(bounds[c + 1] - bounds[c]) / 16);
+            parse_csv_chunk(bounds[c], bounds[c + 1], chunks[c]);
+        }
+        catch (...) {
+            errors[c] = std::current_exception();
+        }
+    });
+
+    for (auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::size_t total = 0;
+    for (auto& chunk : chunks)
+        total += chunk.size();
+
+    std::vector<Point> points;
+    points.reserve(total);
+    for (auto& chunk : chunks)
+        points.insert(points.end(), chunk.begin(), chunk.end());
+
+    long long int endTime = now_us();
+    mLastThroughput = static_cast<double>(file.size()) / static_cast<double>(std::max(1LL, endTime - startTime));
+
+    spdlog::info("[PointLoader] Loaded {} points from CSV file {}, size={} bytes, threads={}, throughput={:.1f} MB/s",
+                 points.size(), path, file.size(), numChunks, mLastThroughput);
+
+    return points;
+}
+
+std::vector<Point> PointLoader::load_binary(const std::string& path) {
+    long long int startTime = now_us();
+
+    MappedFile file(path);
+
+    if (unlikely(file.size() < BINARY_HEADER_SIZE || std::memcmp(file.data(), BINARY_MAGIC, 4) != 0))
+        throw std::runtime_error("[PointLoader] not a binary point file " + path);
+
+    uint32_t version;
+    uint64_t n;
+    std::memcpy(&version, file.data() + 4, sizeof(version));
+    std::memcpy(&n, file.data() + 8, sizeof(n));
+
+    if constexpr (std::endian::native != std::endian::little)
+        n = __builtin_bswap64(n);
+
+    if (unlikely(from_little_endian(version) != BINARY_VERSION))
+        throw std::runtime_error("[PointLoader] unsupported binary point file version");
+
+    // bound n by the file size first, a crafted n could otherwise wrap the expected size around to the actual one
+    if (unlikely(n > (file.size() - BINARY_HEADER_SIZE) / BINARY_RECORD_SIZE
+                 || file.size() != BINARY_HEADER_SIZE + BINARY_RECORD_SIZE * n))
+        throw std::runtime_error("[PointLoader] truncated binary point file " + path);
+
+    auto size = static_cast<std::size_t>(n);
+    const char* ids = file.data() + BINARY_HEADER_SIZE;
+    const char* xs = ids + size * sizeof(uint32_t);
+    const char* ys = xs + size * sizeof(uint32_t);
+
+    std::vector<Point> points(size);
+
+    for (std::size_t i = 0; i < size; ++i) {
+        uint32_t id, x, y;
+        std::memcpy(&id, ids + i * sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&x, xs + i * sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&y, ys + i * sizeof(uint32_t), sizeof(uint32_t));
+
+        points[i].id = from_little_endian(id);
+        points[i].x = from_little_endian(x);
+        points[i].y = from_little_endian(y);
+    }
+
+    long long int endTime = now_us();
+    mLastThroughput = static_cast<double>(file.size()) / static_cast<double>(std::max(1LL, endTime - startTime));
+
+    spdlog::info("[PointLoader] Loaded {} points from binary file {}, size={} bytes, throughput={:.1f} MB/s",
+                 points.size(), path, file.size(), mLastThroughput);
+
+    return points;
+}
+
+void PointLoader::save_csv(const std::string& path, const std::vector<Point>& points) {
+    std::ofstream out(path);
+    if (unlikely(!out))
+        throw std::runtime_error("[PointLoader] cannot write file " + path);
+
+    out << "id,x,y\n";
+    for (auto& point : points)
+        out << point.id << ',' << point.x << ',' << point.y << '\n';
+}
+
+void PointLoader::save_binary(const std::string& path, const std::vector<Point>& points) {
+    std::ofstream out(path, std::ios::binary);
+    if (unlikely(!out))
+        throw std::runtime_error("[PointLoader] cannot write file " + path);
+
+    uint32_t version = from_little_endian(BINARY_VERSION);
+    uint64_t n = points.size();
+    if constexpr (std::endian::native != std::endian::little)
+        n = __builtin_bswap64(n);
+
+    out.write(BINARY_MAGIC, 4);
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+
+    std::vector<uint32_t> column(points.size());
+
+    for (auto field : {&Point::id, &Point::x, &Point::y}) {
+        for (std::size_t i = 0; i < points.size(); ++i)
+            column[i] = from_little_endian(points[i].*field);
+
+        out.write(reinterpret_cast<const char*>(column.data()),
+                  static_cast<std::streamsize>(column.size() * sizeof(uint32_t)));
+    }
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,210 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <spdlog/spdlog.h>
+
+#include "query_planner.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// side length of calibration queries, as fractions of the bounding box
+const std::array<double, 6> CALIBRATION_RANGES{0.001, 0.01, 0.05, 0.2, 0.5, 1.0};
+const unsigned int CALIBRATION_REPEAT = 5;
+const unsigned int CALIBRATION_SEED = 90077;
+
+long long int now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now().time_since_epoch()
+    ).count();
+}
+
+// least square fit of time = fixed + perPoint * k
+EngineCost fit_cost(const std::vector<std::pair<double, double>>& samples) {
+    double n = static_cast<double>(samples.size()), sum_k = 0, sum_t = 0, sum_kk = 0, sum_kt = 0;
+
+    for (auto& [k, t] : samples) {
+        sum_k += k;
+        sum_t += t;
+        sum_kk += k * k;
+        sum_kt += k * t;
+    }
+
+    EngineCost cost;
+    double denominator = n * sum_kk - sum_k * sum_k;
+
+    if (denominator > 0)
+        cost.perPoint = std::max(0.0, (n * sum_kt - sum_k * sum_t) / denominator);
+
+    cost.fixed = std::max(0.0, (sum_t - cost.perPoint * sum_k) / n);
+    return cost;
+}
+
+}
+
+std::string to_string(QueryEngine engine) {
+    switch (engine) {
+        case QueryEngine::FractionalCascading:
+            return "FractionalCascading";
+        case QueryEngine::Original:
+            return "Original";
+        case QueryEngine::Scan:
+            return "Scan";
+        case QueryEngine::Grid:
+            return "Grid";
+    }
+
+    return "Unknown";
+}
+
+void QueryPlanner::construct_tree(std::vector<Point>& points, bool isNaive) {
+    spdlog::info("[QueryPlanner] Start constructing all engines");
+
+    std::vector<Point> fc_copy{points}, org_copy{points};
+    mFcRangeTree.construct_tree(fc_copy, isNaive);
+    mOrgRangeTree.construct_tree(org_copy, isNaive);
+    mScanEngine.construct_tree(points, isNaive);
+    mGridEngine.construct_tree(points, isNaive);
+
+    calibrate(points);
+}
+
+void QueryPlanner::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    std::size_t k = std::min(estimate_output_size(query), limit);
+    QueryEngine chosen = choose_engine(k);
+    auto& cost = mCosts[static_cast<std::size_t>(chosen)];
+
+    PlanChoice choice{query, k, chosen, cost.fixed + cost.perPoint * static_cast<double>(k)};
+    mUsage[static_cast<std::size_t>(chosen)].fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mChoicesMutex);
+
+        if (mChoices.size() < MAX_RECORDED_CHOICES)
+            mChoices.emplace_back(choice);
+        else
+            mChoices[mNumChoices % MAX_RECORDED_CHOICES] = choice;
+
+        ++mNumChoices;
+    }
+
+    engine(chosen).report_points(query, foundPts, limit);
+}
+
+std::size_t QueryPlanner::estimate_output_size(Query query) {
+    return mFcRangeTree.count_points(query);
+}
+
+QueryEngine QueryPlanner::choose_engine(std::size_t k) const {
+    auto best = QueryEngine::FractionalCascading;
+    double best_cost = -1;
+
+    for (std::size_t e = 0; e < NUM_QUERY_ENGINES; ++e) {
+        double cost = mCosts[e].fixed + mCosts[e].perPoint * static_cast<double>(k);
+
+        if (best_cost < 0 || cost < best_cost) {
+            best = static_cast<QueryEngine>(e);
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+void QueryPlanner::calibrate(const std::vector<Point>& points) {
+    if (points.empty())
+        return;
+
+    spdlog::info("[QueryPlanner] Start cost model calibration");
+
+    uint32_t min_x = points[0].x, max_x = points[0].x, min_y = points[0].y, max_y = points[0].y;
+
+    for (auto& point : points) {
+        min_x = std::min(min_x, point.x);
+        max_x = std::max(max_x, point.x);
+        min_y = std::min(min_y, point.y);
+        max_y = std::max(max_y, point.y);
+    }
+
+    std::mt19937 generator(CALIBRATION_SEED);
+    std::array<std::vector<std::pair<double, double>>, NUM_QUERY_ENGINES> samples;
+
+    for (auto rangePer : CALIBRATION_RANGES) {
+        auto range_x = static_cast<uint32_t>(rangePer * (max_x - min_x));
+        auto range_y = static_cast<uint32_t>(rangePer * (max_y - min_y));
+        std::uniform_int_distribution<uint32_t> x_dist(min_x, max_x - range_x), y_dist(min_y, max_y - range_y);
+
+        for (unsigned int i = 0; i < CALIBRATION_REPEAT; ++i) {
+            uint32_t x = x_dist(generator), y = y_dist(generator);
+            Query query(x, x + range_x, y, y + range_y);
+
+            for (std::size_t e = 0; e < NUM_QUERY_ENGINES; ++e) {
+                std::vector<Point> result;
+
+                long long int startTime = now_ns();
+                engine(static_cast<QueryEngine>(e)).report_points(query, result);
+                long long int endTime = now_ns();
+
+                samples[e].emplace_back(static_cast<double>(result.size()), static_cast<double>(endTime - startTime));
+            }
+        }
+    }
+
+    for (std::size_t e = 0; e < NUM_QUERY_ENGINES; ++e) {
+        mCosts[e] = fit_cost(samples[e]);
+        spdlog::info("[QueryPlanner] Calibrated engine={}, fixed cost={}ns, cost per point={}ns",
+                     to_string(static_cast<QueryEngine>(e)), mCosts[e].fixed, mCosts[e].perPoint);
+    }
+}
+
+std::vector<PlanChoice> QueryPlanner::get_choices() const {
+    std::lock_guard<std::mutex> lock(mChoicesMutex);
+
+    // once the ring is full, the oldest choice is the next one to be overwritten
+    std::size_t oldest = mChoices.size() < MAX_RECORDED_CHOICES ? 0 : mNumChoices % MAX_RECORDED_CHOICES;
+    std::vector<PlanChoice> choices(mChoices.begin() + static_cast<std::ptrdiff_t>(oldest), mChoices.end());
+    choices.insert(choices.end(), mChoices.begin(), mChoices.begin() + static_cast<std::ptrdiff_t>(oldest));
+
+    return choices;
+}
+
+void QueryPlanner::clear_choices() {
+    std::lock_guard<std::mutex> lock(mChoicesMutex);
+
+    mChoices.clear();
+    mNumChoices = 0;
+
+    for (auto& usage : mUsage)
+        usage.store(0, std::memory_order_relaxed);
+}
+
+std::array<std::size_t, NUM_QUERY_ENGINES> QueryPlanner::engine_usage() const {
+    std::array<std::size_t, NUM_QUERY_ENGINES> usage{};
+
+    for (std::size_t e = 0; e < NUM_QUERY_ENGINES; ++e)
+        usage[e] = mUsage[e].load(std::memory_order_relaxed);
+
+    return usage;
+}
+
+IRangeTree& QueryPlanner::engine(QueryEngine engine) {
+    switch (engine) {
+        case QueryEngine::FractionalCascading:
+            return mFcRangeTree;
+        case QueryEngine::Original:
+            return mOrgRangeTree;
+        case QueryEngine::Scan:
+            return mScanEngine;
+        case QueryEngine::Grid:
+            return mGridEngine;
+    }
+
+    return mFcRangeTree;
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,298 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+#include "query_replay.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+const char TRACE_MAGIC[4] = {'R', 'T', 'Q', 'T'};
+const uint32_t TRACE_VERSION = 1;
+const std::size_t TRACE_HEADER_SIZE = 16;
+
+// sleeping overshoots by tens of microseconds, so the last stretch before an arrival is spent yielding instead
+const long long int SPIN_THRESHOLD_NS = 100000;
+
+// rates tried by max_sustainable_qps before giving up on finding one that misses the target
+const std::size_t MAX_DOUBLINGS = 32;
+
+// a rate is only sustained if the replay completes at no less than this fraction of it, a short trace may otherwise
+// end before the backlog of an overloaded engine shows in its latency
+const double MIN_SUSTAINED_FRACTION = 0.95;
+
+long long int now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void wait_until(long long int dueNs) {
+    for (long long int remaining = dueNs - now_ns(); remaining > 0; remaining = dueNs - now_ns()) {
+        if (remaining > SPIN_THRESHOLD_NS)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - SPIN_THRESHOLD_NS));
+        else
+            std::this_thread::yield();
+    }
+}
+
+void put_little_endian(std::string& out, uint64_t value, std::size_t numBytes) {
+    for (std::size_t i = 0; i < numBytes; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+uint64_t get_little_endian(const char* in, std::size_t numBytes) {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < numBytes; ++i)
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+
+    return value;
+}
+
+// LEB128, 7 bits per byte, lowest first, the high bit marks that more bytes follow
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t get_varint(const char*& iter, const char* end) {
+    uint64_t value = 0;
+
+    for (unsigned int shift = 0;; shift += 7) {
+        if (unlikely(iter == end || shift > 63))
+            throw std::runtime_error("[QueryTrace] truncated or malformed query trace");
+
+        auto byte = static_cast<uint8_t>(*iter++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+}
+
+void QueryTrace::record(Query query) {
+    long long int now = now_ns();
+    if (mStartNs < 0)
+        mStartNs = now;
+
+    record(query, static_cast<uint64_t>(now - mStartNs));
+}
+
+void QueryTrace::record(Query query, uint64_t timestampNs) {
+    if (unlikely(!mQueries.empty() && timestampNs < mQueries.back().timestampNs))
+        throw std::runtime_error("[QueryTrace] timestamps must not decrease");
+
+    mQueries.push_back({timestampNs, query});
+}
+
+QueryTrace QueryTrace::generate(DataGenerator& generator, std::size_t numQueries, uint32_t range, double qps,
+                                uint32_t seed) {
+    if (unlikely(!(qps > 0)))
+        throw std::runtime_error("[QueryTrace] arrival rate must be positive");
+
+    std::mt19937 rng(seed);
+    std::exponential_distribution<double> interArrival(qps);
+
+    QueryTrace trace;
+    double timestamp = 0;
+
+    for (std::size_t i = 0; i < numQueries; ++i) {
+        trace.record(generator.generate_a_query(range), static_cast<uint64_t>(timestamp * 1e9));
+        timestamp += interArrival(rng);
+    }
+
+    return trace;
+}
+
+double QueryTrace::qps() const {
+    if (mQueries.size() < 2 || mQueries.back().timestampNs == mQueries.front().timestampNs)
+        return 0;
+
+    return static_cast<double>(mQueries.size() - 1) * 1e9
+           / static_cast<double>(mQueries.back().timestampNs - mQueries.front().timestampNs);
+}
+
+void QueryTrace::save(const std::string& path) const {
+    std::string buffer(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    put_little_endian(buffer, TRACE_VERSION, sizeof(uint32_t));
+    put_little_endian(buffer, mQueries.size(), sizeof(uint64_t));
+
+    // widths wrap around for inverted queries, and wrap back on load
+    uint64_t previous = mQueries.empty() ? 0 : mQueries.front().timestampNs;
+
+    for (auto& traced : mQueries) {
+        const Query& query = traced.query;
+
+        put_varint(buffer, traced.timestampNs - previous);
+        put_varint(buffer, query.x_lower);
+        put_varint(buffer, static_cast<uint32_t>(query.x_upper - query.x_lower));
+        put_varint(buffer, query.y_lower);
+        put_varint(buffer, static_cast<uint32_t>(query.y_upper - query.y_lower));
+
+        previous = traced.timestampNs;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (unlikely(!out))
+        throw std::runtime_error("[QueryTrace] cannot write file " + path);
+
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+QueryTrace QueryTrace::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (unlikely(!in))
+        throw std::runtime_error("[QueryTrace] cannot open file " + path);
+
+    std::string buffer{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    if (unlikely(buffer.size() < TRACE_HEADER_SIZE || buffer.compare(0, 4, TRACE_MAGIC, 4) != 0))
+        throw std::runtime_error("[QueryTrace] not a query trace file " + path);
+
+    if (unlikely(get_little_endian(buffer.data() + 4, sizeof(uint32_t)) != TRACE_VERSION))
+        throw std::runtime_error("[QueryTrace] unsupported query trace file version");
+
+    uint64_t n = get_little_endian(buffer.data() + 8, sizeof(uint64_t));
+    const char* iter = buffer.data() + TRACE_HEADER_SIZE;
+    const char* end = buffer.data() + buffer.size();
+
+    // every record takes at least 5 bytes, guards the reservation against a corrupted count
+    if (unlikely(n > static_cast<uint64_t>(end - iter) / 5))
+        throw std::runtime_error("[QueryTrace] truncated query trace file " + path);
+
+    QueryTrace trace;
+    trace.mQueries.reserve(static_cast<std::size_t>(n));
+    uint64_t timestamp = 0;
+
+    for (uint64_t i = 0; i < n; ++i) {
+        timestamp += get_varint(iter, end);
+
+        auto xLower = static_cast<uint32_t>(get_varint(iter, end));
+        auto xUpper = xLower + static_cast<uint32_t>(get_varint(iter, end));
+        auto yLower = static_cast<uint32_t>(get_varint(iter, end));
+        auto yUpper = yLower + static_cast<uint32_t>(get_varint(iter, end));
+
+        trace.mQueries.push_back({timestamp, Query(xLower, xUpper, yLower, yUpper)});
+    }
+
+    spdlog::info("[QueryTrace] Loaded {} queries from {}, size={} bytes, rate={:.0f} qps", trace.size(), path,
+                 buffer.size(), trace.qps());
+
+    return trace;
+}
+
+QueryReplayer::QueryReplayer(IRangeTree& tree, std::size_t numWorkers)
+        : mTree(tree), mPool(std::max<std::size_t>(numWorkers, 1)) {}
+
+ReplayResult QueryReplayer::replay(const QueryTrace& trace, double qps) {
+    TraceScope scope("QueryReplayer::replay");
+
+    const auto& queries = trace.queries();
+    ReplayResult result;
+    result.offeredQps = qps > 0 ? qps : trace.qps();
+
+    if (queries.empty())
+        return result;
+
+    // stretch or compress the arrival times of the trace to the target rate
+    double scale = qps > 0 && trace.qps() > 0 ? trace.qps() / qps : 1;
+    std::size_t numQueries = queries.size();
+    std::vector<long long int> latencies(numQueries);
+
+    // the workers notify under the lock, so this frame cannot return and go out of scope before the last of them has
+    // released it
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    std::size_t done = 0;
+
+    long long int startNs = now_ns();
+
+    for (std::size_t i = 0; i < numQueries; ++i) {
+        auto offset = static_cast<double>(queries[i].timestampNs - queries.front().timestampNs) * scale;
+        long long int dueNs = startNs + static_cast<long long int>(offset);
+
+        // never waits for the earlier queries, a late dispatch still counts from the scheduled arrival
+        wait_until(dueNs);
+
+        mPool.submit([this, &queries, &latencies, &doneMutex, &doneCondition, &done, i, dueNs, numQueries] {
+            std::vector<Point> foundPts;
+            mTree.report_points(queries[i].query, foundPts);
+            latencies[i] = now_ns() - dueNs;
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (++done == numQueries)
+                doneCondition.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [&done, numQueries] { return done == numQueries; });
+    }
+
+    long long int endNs = now_ns();
+
+    for (auto latency : latencies)
+        result.latency.record(static_cast<uint64_t>(std::max(latency, 0LL)));
+
+    result.achievedQps = static_cast<double>(numQueries) * 1e9 / static_cast<double>(std::max(endNs - startNs, 1LL));
+    return result;
+}
+
+double QueryReplayer::max_sustainable_qps(const QueryTrace& trace, double percentile, uint64_t targetNs,
+                                          double startQps, std::size_t numBisections) {
+    auto meets_target = [&](double qps) -> bool {
+        ReplayResult result = replay(trace, qps);
+        uint64_t latency = result.latency.percentile(percentile);
+
+        spdlog::debug("[QueryReplayer] Replayed at {:.0f} qps, achieved {:.0f} qps, p{}={}ns, target={}ns", qps,
+                      result.achievedQps, percentile, latency, targetNs);
+
+        return latency <= targetNs && result.achievedQps >= MIN_SUSTAINED_FRACTION * qps;
+    };
+
+    double good = 0, bad = 0;
+
+    for (std::size_t i = 0; i < MAX_DOUBLINGS && bad == 0; ++i) {
+        double qps = startQps * static_cast<double>(uint64_t{1} << i);
+
+        if (meets_target(qps))
+            good = qps;
+        else
+            bad = qps;
+    }
+
+    if (bad == 0)
+        return good;
+
+    for (std::size_t i = 0; i < numBisections; ++i) {
+        double qps = (good + bad) / 2;
+
+        if (meets_target(qps))
+            good = qps;
+        else
+            bad = qps;
+    }
+
+    return good;
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,142 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <barrier>
+
+#include "radix_sort.h"
+#include "tracer.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// 11 bits per digit, 3 passes per 32 bits key, keep the histogram of each thread in L1
+const unsigned int DIGIT_BITS = 11;
+const std::size_t NUM_BUCKETS = std::size_t{1} << DIGIT_BITS;
+const unsigned int PASSES_PER_KEY = 3;
+
+// do not bother spawning threads for small inputs
+const std::size_t MIN_POINTS_PER_THREAD = 1 << 16;
+
+inline std::size_t digit_of(const Point& point, uint32_t Point::* key, unsigned int shift) {
+    return (point.*key >> shift) & (NUM_BUCKETS - 1);
+}
+
+}
+
+void sort_by_x(std::vector<Point>& points, SortBackend backend, std::vector<Point>& buffer, std::size_t numThreads) {
+    TraceScope trace("sort_by_x");
+
+    if (backend == SortBackend::Radix)
+        radix_sort(points, buffer, {&Point::id, &Point::y, &Point::x}, numThreads);
+    else
+        std::sort(points.begin(), points.end());
+}
+
+void sort_by_y(std::vector<Point>& points, SortBackend backend, std::vector<Point>& buffer, std::size_t numThreads) {
+    TraceScope trace("sort_by_y");
+
+    if (backend == SortBackend::Radix)
+        radix_sort(points, buffer, {&Point::id, &Point::y}, numThreads);
+    else
+        std::sort(points.begin(), points.end(),
+                  [](const Point& a, const Point& b) -> bool
+                  {
+                      return a.y == b.y ? a.id < b.id : a.y < b.y;
+                  });
+}
+
+void radix_sort(std::vector<Point>& points, std::vector<Point>& buffer, const std::vector<uint32_t Point::*>& keys,
+                std::size_t numThreads) {
+    const std::size_t n = points.size();
+    numThreads = std::clamp<std::size_t>(n / MIN_POINTS_PER_THREAD, 1, std::max<std::size_t>(1, numThreads));
+    buffer.resize(n);
+
+    // every pass scatters from source to target, and then the two are swapped
+    Point* source = points.data();
+    Point* target = buffer.data();
+
+    // counts[t][b]: number of points in bucket b of thread t's block, turned into scatter offsets in place
+    std::vector<std::vector<std::size_t>> counts(numThreads, std::vector<std::size_t>(NUM_BUCKETS));
+    std::size_t pass = 0;
+    bool skipPass = false;
+
+    auto block_begin = [&](std::size_t t) { return n * t / numThreads; };
+
+    // runs once per phase by the last thread arriving at the barrier
+    bool scattered = false;
+    auto on_phase_completion = [&]() noexcept {
+        if (scattered) {
+            std::swap(source, target);
+            ++pass;
+            scattered = false;
+            return;
+        }
+
+        // a pass where every point falls into the same bucket does not change the order
+        skipPass = false;
+        for (std::size_t b = 0; b < NUM_BUCKETS && !skipPass; ++b) {
+            std::size_t total = 0;
+            for (std::size_t t = 0; t < numThreads; ++t)
+                total += counts[t][b];
+            skipPass = total == n;
+        }
+
+        std::size_t offset = 0;
+        for (std::size_t b = 0; b < NUM_BUCKETS; ++b) {
+            for (std::size_t t = 0; t < numThreads; ++t) {
+                std::size_t count = counts[t][b];
+                counts[t][b] = offset;
+                offset += count;
+            }
+        }
+
+        scattered = !skipPass;
+        if (skipPass)
+            ++pass;
+    };
+
+    std::barrier sync(static_cast<std::ptrdiff_t>(numThreads), on_phase_completion);
+    const std::size_t numPasses = keys.size() * PASSES_PER_KEY;
+
+    auto worker = [&](std::size_t t) {
+        TraceScope trace("radix_sort worker");
+        const std::size_t begin = block_begin(t), end = block_begin(t + 1);
+
+        while (pass < numPasses) {
+            auto key = keys[pass / PASSES_PER_KEY];
+            auto shift = static_cast<unsigned int>(pass % PASSES_PER_KEY) * DIGIT_BITS;
+            auto& count = counts[t];
+
+            std::fill(count.begin(), count.end(), 0);
+            for (std::size_t i = begin; i < end; ++i)
+                ++count[digit_of(source[i], key, shift)];
+
+            sync.arrive_and_wait();
+
+            if (!skipPass) {
+                for (std::size_t i = begin; i < end; ++i)
+                    target[count[digit_of(source[i], key, shift)]++] = source[i];
+
+                sync.arrive_and_wait();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < numThreads; ++t)
+        workers.emplace_back(worker, t);
+
+    worker(0);
+
+    for (auto& thread : workers)
+        thread.join();
+
+    // the sorted points ended up in the buffer, take over its storage
+    if (source != points.data())
+        std::swap(points, buffer);
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,227 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RANGETREE_X86
+#endif
+
+#include "scan_engine.h"
+#include "thread_pool.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// number of points whose matching indices are collected before they are turned into points
+const std::size_t SCAN_BLOCK_SIZE = 2048;
+
+// do not bother splitting the scan for small inputs
+const std::size_t MIN_POINTS_PER_THREAD = 1 << 16;
+
+// A query in the form of the kernels: lower <= v <= upper iff v - lower <= upper - lower, a single unsigned compare
+struct ScanBounds {
+    uint32_t x_lower;
+    uint32_t x_width;
+    uint32_t y_lower;
+    uint32_t y_width;
+};
+
+// Each kernel writes the indices in [begin, end) of the points in range to out, and returns the number of them
+std::size_t scan_scalar(const uint32_t* xs, const uint32_t* ys, std::size_t begin, std::size_t end, ScanBounds bounds,
+                        uint32_t* out) {
+    std::size_t count = 0;
+
+    for (std::size_t i = begin; i < end; ++i) {
+        out[count] = static_cast<uint32_t>(i);
+        count += (xs[i] - bounds.x_lower <= bounds.x_width) & (ys[i] - bounds.y_lower <= bounds.y_width);
+    }
+
+    return count;
+}
+
+#ifdef RANGETREE_X86
+
+__attribute__((target("avx2")))
+std::size_t scan_avx2(const uint32_t* xs, const uint32_t* ys, std::size_t begin, std::size_t end, ScanBounds bounds,
+                      uint32_t* out) {
+    // AVX2 only compares signed integers, flipping the sign bit of both sides turns it into an unsigned compare
+    const __m256i sign = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+    const __m256i x_lower = _mm256_set1_epi32(static_cast<int32_t>(bounds.x_lower));
+    const __m256i y_lower = _mm256_set1_epi32(static_cast<int32_t>(bounds.y_lower));
+    const __m256i x_width = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(bounds.x_width)), sign);
+    const __m256i y_width = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(bounds.y_width)), sign);
+
+    std::size_t count = 0, i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i));
+
+        __m256i x_out = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_sub_epi32(x, x_lower), sign), x_width);
+        __m256i y_out = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_sub_epi32(y, y_lower), sign), y_width);
+        auto mask = static_cast<unsigned int>(~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(x_out, y_out))))
+                    & 0xFFu;
+
+        while (mask) {
+            out[count++] = static_cast<uint32_t>(i + static_cast<std::size_t>(__builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+
+    return count + scan_scalar(xs, ys, i, end, bounds, out + count);
+}
+
+__attribute__((target("avx512f")))
+std::size_t scan_avx512(const uint32_t* xs, const uint32_t* ys, std::size_t begin, std::size_t end,
+                        ScanBounds bounds, uint32_t* out) {
+    const __m512i x_lower = _mm512_set1_epi32(static_cast<int32_t>(bounds.x_lower));
+    const __m512i y_lower = _mm512_set1_epi32(static_cast<int32_t>(bounds.y_lower));
+    const __m512i x_width = _mm512_set1_epi32(static_cast<int32_t>(bounds.x_width));
+    const __m512i y_width = _mm512_set1_epi32(static_cast<int32_t>(bounds.y_width));
+    const __m512i step = _mm512_set1_epi32(16);
+
+    __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int32_t>(begin)),
+                                       _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    std::size_t count = 0, i = begin;
+
+    for (; i + 16 <= end; i += 16) {
+        __m512i x = _mm512_loadu_si512(xs + i);
+        __m512i y = _mm512_loadu_si512(ys + i);
+
+        __mmask16 mask = _mm512_cmple_epu32_mask(_mm512_sub_epi32(x, x_lower), x_width);
+        mask = _mm512_mask_cmple_epu32_mask(mask, _mm512_sub_epi32(y, y_lower), y_width);
+
+        _mm512_mask_compressstoreu_epi32(out + count, mask, indices);
+        count += static_cast<std::size_t>(__builtin_popcount(mask));
+        indices = _mm512_add_epi32(indices, step);
+    }
+
+    return count + scan_scalar(xs, ys, i, end, bounds, out + count);
+}
+
+#endif
+
+}
+
+std::string to_string(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::Scalar:
+            return "Scalar";
+        case ScanKernel::Avx2:
+            return "AVX2";
+        case ScanKernel::Avx512:
+            return "AVX-512";
+    }
+
+    return "Unknown";
+}
+
+ScanEngine::ScanEngine(std::size_t numThreads)
+        : mNumThreads(std::max<std::size_t>(numThreads, 1)), mKernel(best_kernel()) {}
+
+ScanKernel ScanEngine::best_kernel() {
+#ifdef RANGETREE_X86
+    if (__builtin_cpu_supports("avx512f"))
+        return ScanKernel::Avx512;
+
+    if (__builtin_cpu_supports("avx2"))
+        return ScanKernel::Avx2;
+#endif
+
+    return ScanKernel::Scalar;
+}
+
+void ScanEngine::set_kernel(ScanKernel kernel) {
+    if (unlikely(kernel > best_kernel()))
+        throw std::runtime_error("[ScanEngine] kernel " + to_string(kernel) + " is not supported by the CPU");
+
+    mKernel = kernel;
+}
+
+void ScanEngine::construct_tree(std::vector<Point>& points, bool ) {
+    mIds.resize(points.size());
+    mXs.resize(points.size());
+    mYs.resize(points.size());
+
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        mIds[i] = points[i].id;
+        mXs[i] = points[i].x;
+        mYs[i] = points[i].y;
+    }
+}
+
+void ScanEngine::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    if (query.x_lower > query.x_upper || query.y_lower > query.y_upper || limit == 0)
+        return;
+
+    const std::size_t size = mXs.size();
+    std::size_t numSlices = std::min(mNumThreads, size / MIN_POINTS_PER_THREAD);
+
+    if (numSlices <= 1) {
+        scan_range(0, size, query, foundPts, limit);
+        return;
+    }
+
+    // scan the slices on the shared pool and on this thread, then concatenate them in order
+    std::vector<std::vector<Point>> slicePts(numSlices);
+
+    ThreadPool::shared().parallel_for(numSlices, [&](std::size_t s) {
+        TraceScope trace("ScanEngine slice");
+        scan_range(s * size / numSlices, (s + 1) * size / numSlices, query, slicePts[s], limit);
+    });
+
+    for (auto& pts : slicePts) {
+        std::size_t count = std::min(pts.size(), limit);
+        foundPts.insert(foundPts.end(), pts.begin(), pts.begin() + static_cast<std::ptrdiff_t>(count));
+
+        limit -= count;
+        if (limit == 0)
+            return;
+    }
+}
+
+void ScanEngine::scan_range(std::size_t begin, std::size_t end, Query query, std::vector<Point>& foundPts,
+                            std::size_t limit) const {
+    ScanBounds bounds{query.x_lower, query.x_upper - query.x_lower, query.y_lower, query.y_upper - query.y_lower};
+    uint32_t indices[SCAN_BLOCK_SIZE];
+
+    for (std::size_t blockBegin = begin; blockBegin < end; blockBegin += SCAN_BLOCK_SIZE) {
+        std::size_t blockEnd = std::min(blockBegin + SCAN_BLOCK_SIZE, end), count;
+
+        switch (mKernel) {
+#ifdef RANGETREE_X86
+            case ScanKernel::Avx512:
+                count = scan_avx512(mXs.data(), mYs.data(), blockBegin, blockEnd, bounds, indices);
+                break;
+            case ScanKernel::Avx2:
+                count = scan_avx2(mXs.data(), mYs.data(), blockBegin, blockEnd, bounds, indices);
+                break;
+#endif
+            default:
+                count = scan_scalar(mXs.data(), mYs.data(), blockBegin, blockEnd, bounds, indices);
+        }
+
+        count = std::min(count, limit);
+
+        for (std::size_t j = 0; j < count; ++j) {
+            uint32_t i = indices[j];
+            Point pt(mXs[i], mYs[i]);
+            pt.id = mIds[i];
+            foundPts.emplace_back(pt);
+        }
+
+        limit -= count;
+        if (limit == 0)
+            return;
+    }
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,140 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <spdlog/spdlog.h>
+
+#include "snapshot_manager.h"
+#include "tracer.h"
+
+namespace Xiuge::RangeTree {
+
+// Thread destroying the trees of retired snapshots. The release of the last reference to a snapshot is ordered after
+// every access of its readers, and the tree reaches this thread through the mutex, so it is destroyed only after all
+// of them.
+class SnapshotManager::Reclaimer {
+public:
+    Reclaimer() : mThread([this] { run(); }) {}
+
+    ~Reclaimer() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+            mCondition.notify_one();
+        }
+
+        mThread.join();
+    }
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    void retire(FcRangeTree* tree) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRetired.emplace_back(tree);
+        mCondition.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        while (true) {
+            mCondition.wait(lock, [this] { return mStopping || !mRetired.empty(); });
+
+            if (mRetired.empty())
+                return;
+
+            std::vector<std::unique_ptr<FcRangeTree>> retired;
+            retired.swap(mRetired);
+
+            // destroy outside the lock, the readers retiring other snapshots meanwhile must not wait for it
+            lock.unlock();
+            TraceScope trace("SnapshotManager reclaim");
+            retired.clear();
+            lock.lock();
+
+            spdlog::debug("[SnapshotManager] Reclaimed retired snapshots");
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<std::unique_ptr<FcRangeTree>> mRetired;
+    bool mStopping = false;
+    // started last, after the fields it uses
+    std::thread mThread;
+};
+
+SnapshotManager::SnapshotManager() : mReclaimer(std::make_shared<Reclaimer>()) {}
+
+SnapshotManager::~SnapshotManager() {
+    std::thread rebuilder;
+
+    {
+        std::lock_guard<std::mutex> lock(mRebuildMutex);
+        rebuilder.swap(mRebuilder);
+    }
+
+    // joins the whole chain of rebuilds, each of them joined its predecessor
+    if (rebuilder.joinable())
+        rebuilder.join();
+}
+
+void SnapshotManager::construct_tree(std::vector<Point>& points, bool ) {
+    rebuild_async(points);
+    wait_rebuild();
+}
+
+void SnapshotManager::report_points(Query query, std::vector<Point>& foundPts, std::size_t limit) {
+    Snapshot snapshot = acquire();
+
+    if (snapshot)
+        snapshot->report_points(query, foundPts, limit);
+}
+
+void SnapshotManager::rebuild_async(std::vector<Point> points) {
+    std::lock_guard<std::mutex> lock(mRebuildMutex);
+
+    ++mNumRequested;
+
+    std::thread previous;
+    previous.swap(mRebuilder);
+
+    mRebuilder = std::thread([this, previous = std::move(previous), points = std::move(points)]() mutable {
+        if (previous.joinable())
+            previous.join();
+
+        rebuild(points);
+
+        std::lock_guard<std::mutex> doneLock(mRebuildMutex);
+        ++mNumCompleted;
+        mRebuildDone.notify_all();
+    });
+}
+
+void SnapshotManager::wait_rebuild() {
+    std::unique_lock<std::mutex> lock(mRebuildMutex);
+
+    uint64_t requested = mNumRequested;
+    mRebuildDone.wait(lock, [this, requested] { return mNumCompleted >= requested; });
+}
+
+void SnapshotManager::rebuild(std::vector<Point>& points) {
+    TraceScope trace("SnapshotManager::rebuild");
+
+    auto tree = std::make_unique<FcRangeTree>();
+    tree->construct_tree(points, false);
+
+    // the deleter runs on whichever thread releases the last reference, it only hands the tree over
+    Snapshot snapshot(tree.release(), [reclaimer = mReclaimer](FcRangeTree* retired) { reclaimer->retire(retired); });
+
+    // libstdc++ takes the spin lock of the atomic with the order given to store, so release alone would not order it
+    // after the readers' unlock
+    mCurrent.store(std::move(snapshot));
+    uint64_t version = mVersion.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    spdlog::info("[SnapshotManager] Published snapshot version={} with {} points", version, points.size());
+}
+
+} // namespace ::Xiuge::RangeTree
@@ -0,0 +1,98 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <latch>
+
+#include "thread_pool.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// pool whose worker is the current thread, if any
+thread_local ThreadPool* tCurrentPool = nullptr;
+
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads) {
+    numThreads = std::max<std::size_t>(1, numThreads);
+
+    for (std::size_t i = 0; i < numThreads; ++i)
+        mWorkers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+
+    mCondition.notify_all();
+
+    for (auto& worker : mWorkers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push(std::move(task));
+    }
+
+    mCondition.notify_one();
+}
+
+void ThreadPool::parallel_for(std::size_t num, const std::function<void(std::size_t)>& fn) {
+    if (num == 0)
+        return;
+
+    if (tCurrentPool == this) {
+        for (std::size_t i = 0; i < num; ++i)
+            fn(i);
+
+        return;
+    }
+
+    std::latch done(static_cast<std::ptrdiff_t>(num - 1));
+
+    for (std::size_t i = 1; i < num; ++i) {
+        submit([&fn, &done, i] {
+            fn(i);
+            done.count_down();
+        });
+    }
+
+    fn(0);
+    done.wait();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::worker_loop() {
+    tCurrentPool = this;
+
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+
+            // drain the queue before stopping
+            if (mTasks.empty())
+                return;
+
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+
+        task();
+    }
+}
+
+} // namespace ::Xiuge::RangeTree
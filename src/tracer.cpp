@@ -0,0 +1,151 @@
+//
+// Created by Xiuge Chen on 10/18/26.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "tracer.h"
+#include "utils.h"
+
+namespace Xiuge::RangeTree {
+
+namespace {
+
+// escape the characters JSON does not allow in a string
+void write_json_string(std::ostream& out, const char* str) {
+    out << '"';
+
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            out << '\\' << *str;
+        else if (static_cast<unsigned char>(*str) < 0x20)
+            out << ' ';
+        else
+            out << *str;
+    }
+
+    out << '"';
+}
+
+}
+
+Tracer& Tracer::shared() {
+    static Tracer tracer;
+    return tracer;
+}
+
+int64_t Tracer::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::record(const char* name, int64_t beginNs, int64_t endNs) {
+    Ring& ring = local_ring();
+    std::size_t written = ring.written.load(std::memory_order_relaxed);
+
+    // claim the slot before overwriting it, so that an export reading it concurrently finds out
+    ring.claimed.store(written + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Event& event = ring.events[written % RING_CAPACITY];
+    event.name.store(name, std::memory_order_relaxed);
+    event.beginNs.store(beginNs, std::memory_order_relaxed);
+    event.endNs.store(endNs, std::memory_order_relaxed);
+
+    ring.written.store(written + 1, std::memory_order_release);
+}
+
+auto Tracer::local_ring() -> Ring& {
+    // the shared tracer is the only instance, so one ring per thread, handed back when the thread exits
+    struct LocalRing {
+        Ring* ring = nullptr;
+
+        ~LocalRing() {
+            if (ring) {
+                Tracer& tracer = Tracer::shared();
+                std::lock_guard<std::mutex> lock(tracer.mMutex);
+                tracer.mFreeRings.emplace_back(ring);
+            }
+        }
+    };
+
+    thread_local LocalRing localRing;
+
+    if (likely(localRing.ring != nullptr))
+        return *localRing.ring;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mFreeRings.empty()) {
+        localRing.ring = mFreeRings.back();
+        mFreeRings.pop_back();
+    }
+    else {
+        mRings.emplace_back(std::make_unique<Ring>());
+        mRings.back()->tid = mRings.size() - 1;
+        localRing.ring = mRings.back().get();
+    }
+
+    return *localRing.ring;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto& ring : mRings)
+        ring->cleared.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void Tracer::write_chrome_json(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    out << "{\"traceEvents\":[";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+
+    for (auto& ring : mRings) {
+        out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << ring->tid
+            << R"(,"args":{"name":"thread )" << ring->tid << "\"}}";
+        first = false;
+
+        // oldest first, a full ring starts right after the last event written
+        std::size_t written = ring->written.load(std::memory_order_acquire);
+        std::size_t begin = std::max(ring->cleared.load(std::memory_order_relaxed),
+                                     written - std::min(written, RING_CAPACITY));
+
+        for (std::size_t i = begin; i < written; ++i) {
+            const Event& event = ring->events[i % RING_CAPACITY];
+            const char* name = event.name.load(std::memory_order_relaxed);
+            int64_t beginNs = event.beginNs.load(std::memory_order_relaxed);
+            int64_t endNs = event.endNs.load(std::memory_order_relaxed);
+
+            // skip the slot if the thread has started to overwrite it with a later event
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (ring->claimed.load(std::memory_order_relaxed) > i + RING_CAPACITY)
+                continue;
+
+            out << ",\n{\"name\":";
+            write_json_string(out, name);
+            out << R"(,"cat":"rangetree","ph":"X","pid":1,"tid":)" << ring->tid
+                << ",\"ts\":" << static_cast<double>(beginNs) / 1000.0
+                << ",\"dur\":" << static_cast<double>(endNs - beginNs) / 1000.0 << "}";
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Tracer::dump_chrome_json(const std::string& path) const {
+    std::ofstream out(path);
+
+    if (unlikely(!out))
+        throw std::runtime_error("[Tracer] cannot open file " + path);
+
+    write_chrome_json(out);
+}
+
+} // namespace ::Xiuge::RangeTree